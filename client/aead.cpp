@@ -0,0 +1,79 @@
+#include "aead.h"
+#include "aeadbackends.h"
+
+#include <cstring>
+
+namespace CryptoUtils {
+
+    ChaChaBackend chachaBackend() {
+        const CpuFeatures& cpu = cpuFeatures();
+        if (cpu.avx2) return ChaChaBackend::Avx2;
+        if (cpu.sse2) return ChaChaBackend::Sse2;
+        return ChaChaBackend::Scalar;
+    }
+
+    namespace {
+        // Comparação em tempo constante: não revela quantos bytes da tag conferem
+        bool tagsEqual(const uint8_t* a, const uint8_t* b) {
+            uint8_t diff = 0;
+            for (size_t i = 0; i < AEAD_TAG_BYTES; ++i) {
+                diff |= a[i] ^ b[i];
+            }
+            return diff == 0;
+        }
+    }
+
+    void aeadInit(AeadKey& key, const uint8_t bytes[AEAD_KEY_BYTES]) {
+        memcpy(key.bytes, bytes, AEAD_KEY_BYTES);
+        aesGcmInit(key, cpuFeatures().aesni);
+    }
+
+    AeadAlgorithm preferredAead() {
+        return cpuFeatures().aesni ? AeadAlgorithm::AesGcm : AeadAlgorithm::ChaCha20Poly1305;
+    }
+
+    const char* aeadBackendName(AeadAlgorithm algorithm) {
+        switch (algorithm) {
+            case AeadAlgorithm::AesGcm:
+                return cpuFeatures().aesni ? "AES-256-GCM (AES-NI/PCLMUL)" : "AES-256-GCM (portable)";
+            case AeadAlgorithm::ChaCha20Poly1305:
+                switch (chachaBackend()) {
+                    case ChaChaBackend::Avx2: return "ChaCha20-Poly1305 (AVX2)";
+                    case ChaChaBackend::Sse2: return "ChaCha20-Poly1305 (SSE2)";
+                    default: return "ChaCha20-Poly1305 (portable)";
+                }
+        }
+        return "unknown";
+    }
+
+    void aeadSeal(AeadAlgorithm algorithm, const AeadKey& key, const uint8_t nonce[AEAD_NONCE_BYTES],
+                  const uint8_t* aad, size_t aadLength, const uint8_t* plaintext, size_t length, uint8_t* out) {
+        if (algorithm == AeadAlgorithm::AesGcm) {
+            aesGcmSeal(key, nonce, aad, aadLength, plaintext, length, out, out + length, cpuFeatures().aesni);
+        } else {
+            chachaPolySeal(key, nonce, aad, aadLength, plaintext, length, out, out + length, chachaBackend());
+        }
+    }
+
+    bool aeadOpen(AeadAlgorithm algorithm, const AeadKey& key, const uint8_t nonce[AEAD_NONCE_BYTES],
+                  const uint8_t* aad, size_t aadLength, const uint8_t* ciphertext, size_t length, uint8_t* out) {
+        if (length < AEAD_TAG_BYTES) {
+            return false;
+        }
+        size_t bodyLength = length - AEAD_TAG_BYTES;
+        uint8_t tag[AEAD_TAG_BYTES];
+        if (algorithm == AeadAlgorithm::AesGcm) {
+            aesGcmOpen(key, nonce, aad, aadLength, ciphertext, bodyLength, out, tag, cpuFeatures().aesni);
+        } else if (algorithm == AeadAlgorithm::ChaCha20Poly1305) {
+            chachaPolyOpen(key, nonce, aad, aadLength, ciphertext, bodyLength, out, tag, chachaBackend());
+        } else {
+            memset(out, 0, bodyLength);
+            return false;
+        }
+        if (!tagsEqual(tag, ciphertext + bodyLength)) {
+            memset(out, 0, bodyLength);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace CryptoUtils {
+
+    const size_t AEAD_KEY_BYTES = 32;
+    const size_t AEAD_NONCE_BYTES = 12;
+    const size_t AEAD_TAG_BYTES = 16;
+
+    // Vai no primeiro byte de cada mensagem cifrada: quem decifra usa o mesmo algoritmo
+    enum class AeadAlgorithm : uint8_t {
+        AesGcm = 1,            // AES-256-GCM
+        ChaCha20Poly1305 = 2,  // RFC 8439
+    };
+
+    /**
+     * @brief Chave de 256 bits pronta para os dois algoritmos. O key schedule do AES e
+     * as potências de H do GHASH são calculados uma vez por chave, não por mensagem.
+     */
+    struct AeadKey {
+        uint8_t bytes[AEAD_KEY_BYTES];
+        alignas(16) uint8_t aesRoundKeys[15][16];
+        uint8_t ghashKey[16];                   // H = AES(0), big-endian
+        alignas(16) uint8_t ghashPowers[4][16]; // H^1..H^4 no formato do backend com PCLMUL
+    };
+
+    void aeadInit(AeadKey& key, const uint8_t bytes[AEAD_KEY_BYTES]);
+
+    // Algoritmo mais rápido nesta CPU (AES-GCM com AES-NI, senão ChaCha20-Poly1305),
+    // escolhido pelo cpuid na primeira chamada
+    AeadAlgorithm preferredAead();
+    const char* aeadBackendName(AeadAlgorithm algorithm);
+
+    // 'out' recebe length + AEAD_TAG_BYTES bytes (ciphertext seguido da tag)
+    void aeadSeal(AeadAlgorithm algorithm, const AeadKey& key, const uint8_t nonce[AEAD_NONCE_BYTES],
+                  const uint8_t* aad, size_t aadLength, const uint8_t* plaintext, size_t length, uint8_t* out);
+
+    // 'length' inclui a tag e 'out' recebe length - AEAD_TAG_BYTES bytes. Retorna false
+    // (e zera 'out') se a tag não confere ou o algoritmo é desconhecido.
+    bool aeadOpen(AeadAlgorithm algorithm, const AeadKey& key, const uint8_t nonce[AEAD_NONCE_BYTES],
+                  const uint8_t* aad, size_t aadLength, const uint8_t* ciphertext, size_t length, uint8_t* out);
+
+    /**
+     * @brief Vetores conhecidos em cada backend que esta CPU roda: GCM test case 16,
+     * RFC 8439 §2.8.2 e RFC 5869 test case 1 (HKDF). Os caminhos vetorizados também
+     * são comparados com o portável numa mensagem longa. Escreve uma linha por
+     * verificação em 'log' (se não for nulo) e retorna false se alguma falhar.
+     * Implementada em aeadselftest.cpp.
+     */
+    bool aeadSelfTest(std::FILE* log);
+}
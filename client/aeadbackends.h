@@ -0,0 +1,28 @@
+#pragma once
+
+#include "aead.h"
+#include "cpufeatures.h"
+
+// Implementações usadas por aead.cpp; cada uma tem uma versão portável e uma com
+// instruções específicas, que só é chamada se o cpuid disser que a CPU as tem.
+namespace CryptoUtils {
+
+    // aesgcm.cpp
+    void aesGcmInit(AeadKey& key, bool clmul);
+    void aesGcmSeal(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, bool aesni);
+    void aesGcmOpen(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, bool aesni);
+
+    // chacha20poly1305.cpp; 'tag' recebe a tag calculada sobre o ciphertext
+    enum class ChaChaBackend { Scalar, Sse2, Avx2 };
+    ChaChaBackend chachaBackend();  // aead.cpp: o mais largo que a CPU suporta
+    void chachaPolySeal(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                        const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, ChaChaBackend backend);
+    void chachaPolyOpen(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                        const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, ChaChaBackend backend);
+
+    // Só o keystream do ChaCha20 (a partir do bloco 'counter'), usado pelo gerador aleatório
+    void chacha20Stream(const uint8_t key[32], const uint8_t nonce[12], uint32_t counter,
+                        uint8_t* out, size_t length, ChaChaBackend backend);
+}
@@ -0,0 +1,178 @@
+#include "aead.h"
+#include "aeadbackends.h"
+#include "sha256.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace CryptoUtils {
+
+    namespace {
+        std::vector<uint8_t> fromHex(const char* hex) {
+            std::vector<uint8_t> bytes;
+            for (size_t i = 0; hex[i] && hex[i + 1]; i += 2) {
+                bytes.push_back((uint8_t)std::stoul(std::string(hex + i, 2), nullptr, 16));
+            }
+            return bytes;
+        }
+
+        struct AeadVector {
+            const char* name;
+            const char* key;
+            const char* nonce;
+            const char* aad;
+            const char* plaintext;
+            const char* ciphertext;
+            const char* tag;
+        };
+
+        // Test Case 16 da especificação do GCM (McGrew e Viega): AES-256, AAD de 20 bytes
+        const AeadVector GCM_CASE_16 = {
+            "GCM test case 16",
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+            "cafebabefacedbaddecaf888",
+            "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+            "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+            "76fc6ece0f4e1768cddf8853bb2d551b",
+        };
+
+        // RFC 8439 §2.8.2: "Ladies and Gentlemen of the class of '99: ..."
+        const AeadVector RFC8439_2_8_2 = {
+            "RFC 8439 2.8.2",
+            "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+            "070000004041424344454647",
+            "50515253c0c1c2c3c4c5c6c7",
+            "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+            "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+            "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+            "637265656e20776f756c642062652069742e",
+            "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+            "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+            "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+            "3ff4def08e4b7a9de576d26586cec64b6116",
+            "1ae10b594f09e26a7e902ecbd0600691",
+        };
+
+        // Uma implementação concreta: algoritmo + caminho (portável ou com instruções da CPU)
+        struct Backend {
+            const char* name;
+            bool gcm;
+            bool fast;  // Com AES-NI/PCLMUL (só GCM)
+            ChaChaBackend chacha;
+        };
+
+        void seal(const Backend& b, const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                  const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag) {
+            if (b.gcm) {
+                aesGcmSeal(key, nonce, aad, aadLength, in, length, out, tag, b.fast);
+            } else {
+                chachaPolySeal(key, nonce, aad, aadLength, in, length, out, tag, b.chacha);
+            }
+        }
+
+        void open(const Backend& b, const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                  const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag) {
+            if (b.gcm) {
+                aesGcmOpen(key, nonce, aad, aadLength, in, length, out, tag, b.fast);
+            } else {
+                chachaPolyOpen(key, nonce, aad, aadLength, in, length, out, tag, b.chacha);
+            }
+        }
+
+        void loadKey(const Backend& b, AeadKey& key, const uint8_t* bytes) {
+            memcpy(key.bytes, bytes, AEAD_KEY_BYTES);
+            aesGcmInit(key, b.gcm && b.fast);
+        }
+
+        bool report(std::FILE* log, bool ok, const char* check, const char* backend) {
+            if (log) {
+                std::fprintf(log, "%-4s %s, %s\n", ok ? "ok" : "FAIL", check, backend);
+            }
+            return ok;
+        }
+
+        // Cifra e decifra o vetor; o ciphertext e a tag têm que bater byte a byte
+        bool checkVector(std::FILE* log, const Backend& b, const AeadVector& v) {
+            std::vector<uint8_t> key = fromHex(v.key), nonce = fromHex(v.nonce), aad = fromHex(v.aad);
+            std::vector<uint8_t> plaintext = fromHex(v.plaintext), ciphertext = fromHex(v.ciphertext);
+            std::vector<uint8_t> expectedTag = fromHex(v.tag);
+
+            AeadKey aeadKey;
+            loadKey(b, aeadKey, key.data());
+            std::vector<uint8_t> out(plaintext.size());
+            uint8_t tag[AEAD_TAG_BYTES];
+            seal(b, aeadKey, nonce.data(), aad.data(), aad.size(), plaintext.data(), plaintext.size(), out.data(), tag);
+            bool ok = out == ciphertext && memcmp(tag, expectedTag.data(), sizeof(tag)) == 0;
+
+            open(b, aeadKey, nonce.data(), aad.data(), aad.size(), ciphertext.data(), ciphertext.size(), out.data(), tag);
+            ok = ok && out == plaintext && memcmp(tag, expectedTag.data(), sizeof(tag)) == 0;
+            return report(log, ok, v.name, b.name);
+        }
+
+        // Os vetores são curtos demais para os laços de 4 blocos do AES-NI e de 256/512
+        // bytes do SSE2/AVX2; uma mensagem longa tem que sair igual à do caminho portável
+        bool checkAgainstPortable(std::FILE* log, const Backend& b, const Backend& portable) {
+            const size_t LENGTH = 1500;  // Passa por todos os laços e ainda deixa um resto
+            uint8_t keyBytes[AEAD_KEY_BYTES], nonce[AEAD_NONCE_BYTES], aad[7];
+            std::vector<uint8_t> plaintext(LENGTH);
+            for (size_t i = 0; i < sizeof(keyBytes); ++i) keyBytes[i] = (uint8_t)(i * 7 + 1);
+            for (size_t i = 0; i < sizeof(nonce); ++i) nonce[i] = (uint8_t)(i * 13 + 5);
+            for (size_t i = 0; i < sizeof(aad); ++i) aad[i] = (uint8_t)(i + 0xa0);
+            for (size_t i = 0; i < LENGTH; ++i) plaintext[i] = (uint8_t)(i * 31 + 17);
+
+            AeadKey key, portableKey;
+            loadKey(b, key, keyBytes);
+            loadKey(portable, portableKey, keyBytes);
+            std::vector<uint8_t> out(LENGTH), expected(LENGTH), opened(LENGTH);
+            uint8_t tag[AEAD_TAG_BYTES], expectedTag[AEAD_TAG_BYTES], openedTag[AEAD_TAG_BYTES];
+            seal(b, key, nonce, aad, sizeof(aad), plaintext.data(), LENGTH, out.data(), tag);
+            seal(portable, portableKey, nonce, aad, sizeof(aad), plaintext.data(), LENGTH, expected.data(), expectedTag);
+            open(b, key, nonce, aad, sizeof(aad), out.data(), LENGTH, opened.data(), openedTag);
+
+            bool ok = out == expected && memcmp(tag, expectedTag, sizeof(tag)) == 0 &&
+                      opened == plaintext && memcmp(openedTag, expectedTag, sizeof(tag)) == 0;
+            return report(log, ok, "1500 bytes vs portable", b.name);
+        }
+
+        bool checkHkdf(std::FILE* log) {
+            // RFC 5869, Test Case 1
+            std::vector<uint8_t> ikm(22, 0x0b), salt = fromHex("000102030405060708090a0b0c");
+            std::vector<uint8_t> info = fromHex("f0f1f2f3f4f5f6f7f8f9");
+            std::vector<uint8_t> expected = fromHex("3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf"
+                                                    "34007208d5b887185865");
+            std::vector<uint8_t> okm(expected.size());
+            hkdfSha256(std::string(salt.begin(), salt.end()), ikm.data(), ikm.size(),
+                       std::string(info.begin(), info.end()), okm.data(), okm.size());
+            return report(log, okm == expected, "RFC 5869 test case 1", "HKDF-SHA256");
+        }
+    }
+
+    bool aeadSelfTest(std::FILE* log) {
+        const CpuFeatures& cpu = cpuFeatures();
+        const Backend gcmPortable = {"AES-256-GCM (portable)", true, false, ChaChaBackend::Scalar};
+        const Backend chachaScalar = {"ChaCha20-Poly1305 (portable)", false, false, ChaChaBackend::Scalar};
+
+        std::vector<Backend> gcm = {gcmPortable};
+        if (cpu.aesni) gcm.push_back({"AES-256-GCM (AES-NI/PCLMUL)", true, true, ChaChaBackend::Scalar});
+        std::vector<Backend> chacha = {chachaScalar};
+        if (cpu.sse2) chacha.push_back({"ChaCha20-Poly1305 (SSE2)", false, false, ChaChaBackend::Sse2});
+        if (cpu.avx2) chacha.push_back({"ChaCha20-Poly1305 (AVX2)", false, false, ChaChaBackend::Avx2});
+
+        // Sem curto-circuito: todas as verificações rodam e aparecem no log
+        bool ok = true;
+        for (const Backend& b : gcm) {
+            ok &= checkVector(log, b, GCM_CASE_16);
+            if (b.fast) ok &= checkAgainstPortable(log, b, gcmPortable);
+        }
+        for (const Backend& b : chacha) {
+            ok &= checkVector(log, b, RFC8439_2_8_2);
+            if (b.chacha != ChaChaBackend::Scalar) ok &= checkAgainstPortable(log, b, chachaScalar);
+        }
+        ok &= checkHkdf(log);
+        return ok;
+    }
+}
@@ -0,0 +1,399 @@
+#include "aeadbackends.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AEAD_X86 1
+#endif
+
+namespace CryptoUtils {
+
+    namespace {
+
+        // ====================================================================
+        // AES-256 e GHASH portáveis: referência e fallback sem AES-NI
+        // ====================================================================
+
+        const uint8_t SBOX[256] = {
+            0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+            0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+            0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+            0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+            0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+            0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+            0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+            0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+            0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+            0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+            0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+            0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+            0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+            0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+            0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+            0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+        };
+
+        inline uint8_t xtime(uint8_t x) { return (uint8_t)((x << 1) ^ ((x >> 7) * 0x1b)); }
+
+        void expandKey(const uint8_t key[32], uint8_t roundKeys[15][16]) {
+            uint8_t* w = &roundKeys[0][0];
+            memcpy(w, key, 32);
+            uint8_t rcon = 1;
+            for (int i = 8; i < 60; ++i) {
+                uint8_t t[4];
+                memcpy(t, w + 4 * (i - 1), 4);
+                if (i % 8 == 0) {
+                    uint8_t first = t[0];
+                    t[0] = SBOX[t[1]] ^ rcon;
+                    t[1] = SBOX[t[2]];
+                    t[2] = SBOX[t[3]];
+                    t[3] = SBOX[first];
+                    rcon = xtime(rcon);
+                } else if (i % 8 == 4) {
+                    for (uint8_t& b : t) {
+                        b = SBOX[b];
+                    }
+                }
+                for (int k = 0; k < 4; ++k) {
+                    w[4 * i + k] = w[4 * (i - 8) + k] ^ t[k];
+                }
+            }
+        }
+
+        void encryptBlock(const uint8_t roundKeys[15][16], const uint8_t in[16], uint8_t out[16]) {
+            uint8_t s[16];
+            for (int i = 0; i < 16; ++i) {
+                s[i] = in[i] ^ roundKeys[0][i];
+            }
+            for (int round = 1; round <= 14; ++round) {
+                uint8_t t[16];
+                // SubBytes + ShiftRows (estado em colunas: byte r + 4c)
+                for (int c = 0; c < 4; ++c) {
+                    for (int r = 0; r < 4; ++r) {
+                        t[r + 4 * c] = SBOX[s[r + 4 * ((c + r) % 4)]];
+                    }
+                }
+                if (round < 14) {
+                    for (int c = 0; c < 4; ++c) {
+                        uint8_t* col = t + 4 * c;
+                        uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                        uint8_t first = col[0];
+                        col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                        col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                        col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                        col[3] ^= all ^ xtime(col[3] ^ first);
+                    }
+                }
+                for (int i = 0; i < 16; ++i) {
+                    s[i] = t[i] ^ roundKeys[round][i];
+                }
+            }
+            memcpy(out, s, 16);
+        }
+
+        uint64_t loadBe64(const uint8_t* p) {
+            uint64_t v = 0;
+            for (int i = 0; i < 8; ++i) {
+                v = v << 8 | p[i];
+            }
+            return v;
+        }
+
+        void storeBe64(uint8_t* p, uint64_t v) {
+            for (int i = 7; i >= 0; --i) {
+                p[i] = (uint8_t)v;
+                v >>= 8;
+            }
+        }
+
+        // X = X * H em GF(2^128), bit a bit (convenção do GCM: bit 0 é o mais significativo)
+        void gfMultiply(uint64_t& xHi, uint64_t& xLo, uint64_t hHi, uint64_t hLo) {
+            uint64_t zHi = 0, zLo = 0;
+            uint64_t vHi = hHi, vLo = hLo;
+            for (int i = 0; i < 128; ++i) {
+                uint64_t bit = i < 64 ? (xHi >> (63 - i)) & 1 : (xLo >> (127 - i)) & 1;
+                uint64_t mask = 0 - bit;
+                zHi ^= vHi & mask;
+                zLo ^= vLo & mask;
+                uint64_t carry = 0 - (vLo & 1);
+                vLo = (vLo >> 1) | (vHi << 63);
+                vHi = (vHi >> 1) ^ (0xe100000000000000ULL & carry);
+            }
+            xHi = zHi;
+            xLo = zLo;
+        }
+
+        struct PortableGhash {
+            uint64_t hHi, hLo, xHi = 0, xLo = 0;
+
+            explicit PortableGhash(const uint8_t h[16]) : hHi(loadBe64(h)), hLo(loadBe64(h + 8)) {}
+
+            // Blocos incompletos são completados com zeros
+            void update(const uint8_t* data, size_t length) {
+                while (length > 0) {
+                    uint8_t block[16] = {0};
+                    size_t take = length < 16 ? length : 16;
+                    memcpy(block, data, take);
+                    xHi ^= loadBe64(block);
+                    xLo ^= loadBe64(block + 8);
+                    gfMultiply(xHi, xLo, hHi, hLo);
+                    data += take;
+                    length -= take;
+                }
+            }
+
+            void finish(size_t aadLength, size_t length, uint8_t out[16]) {
+                xHi ^= (uint64_t)aadLength * 8;
+                xLo ^= (uint64_t)length * 8;
+                gfMultiply(xHi, xLo, hHi, hLo);
+                storeBe64(out, xHi);
+                storeBe64(out + 8, xLo);
+            }
+        };
+
+        void counterBlock(const uint8_t* nonce, uint32_t counter, uint8_t block[16]) {
+            memcpy(block, nonce, 12);
+            block[12] = (uint8_t)(counter >> 24);
+            block[13] = (uint8_t)(counter >> 16);
+            block[14] = (uint8_t)(counter >> 8);
+            block[15] = (uint8_t)counter;
+        }
+
+        void portableCtr(const AeadKey& key, const uint8_t* nonce, const uint8_t* in, size_t length, uint8_t* out) {
+            uint32_t counter = 2;  // 1 é o bloco J0, que cifra a tag
+            for (size_t offset = 0; offset < length; offset += 16, ++counter) {
+                uint8_t block[16], stream[16];
+                counterBlock(nonce, counter, block);
+                encryptBlock(key.aesRoundKeys, block, stream);
+                size_t take = length - offset < 16 ? length - offset : 16;
+                for (size_t i = 0; i < take; ++i) {
+                    out[offset + i] = in[offset + i] ^ stream[i];
+                }
+            }
+        }
+
+        void portableTag(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                         const uint8_t* ciphertext, size_t length, uint8_t* tag) {
+            PortableGhash ghash(key.ghashKey);
+            ghash.update(aad, aadLength);
+            ghash.update(ciphertext, length);
+            uint8_t s[16], j0[16], mask[16];
+            ghash.finish(aadLength, length, s);
+            counterBlock(nonce, 1, j0);
+            encryptBlock(key.aesRoundKeys, j0, mask);
+            for (int i = 0; i < 16; ++i) {
+                tag[i] = s[i] ^ mask[i];
+            }
+        }
+
+#ifdef AEAD_X86
+        // ====================================================================
+        // AES-NI + PCLMULQDQ: 4 blocos por vez no CTR e no GHASH (H^4..H^1)
+        // ====================================================================
+
+#define AESNI_TARGET __attribute__((target("aes,pclmul,sse4.1")))
+
+        AESNI_TARGET inline __m128i byteSwap(__m128i x) {
+            return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+
+        // Produto em GF(2^128) com os operandos em ordem de bytes invertida (Gueron/Kounavis)
+        AESNI_TARGET inline __m128i gfMultiplyClmul(__m128i a, __m128i b) {
+            __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+            __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+            __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+            lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+            hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+            // Desloca o produto de 256 bits um bit para a esquerda (bits refletidos)
+            __m128i loCarry = _mm_srli_epi32(lo, 31);
+            __m128i hiCarry = _mm_srli_epi32(hi, 31);
+            lo = _mm_slli_epi32(lo, 1);
+            hi = _mm_slli_epi32(hi, 1);
+            __m128i crossing = _mm_srli_si128(loCarry, 12);
+            hiCarry = _mm_slli_si128(hiCarry, 4);
+            loCarry = _mm_slli_si128(loCarry, 4);
+            lo = _mm_or_si128(lo, loCarry);
+            hi = _mm_or_si128(hi, hiCarry);
+            hi = _mm_or_si128(hi, crossing);
+
+            // Redução módulo x^128 + x^7 + x^2 + x + 1
+            __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+            __m128i tHigh = _mm_srli_si128(t, 4);
+            lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+            __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+            u = _mm_xor_si128(u, tHigh);
+            lo = _mm_xor_si128(lo, u);
+            return _mm_xor_si128(hi, lo);
+        }
+
+        AESNI_TARGET void clmulPowers(AeadKey& key) {
+            __m128i h = byteSwap(_mm_loadu_si128((const __m128i*)key.ghashKey));
+            __m128i power = h;
+            for (int i = 0; i < 4; ++i) {
+                _mm_store_si128((__m128i*)key.ghashPowers[i], power);
+                power = gfMultiplyClmul(power, h);
+            }
+        }
+
+        struct AesNiContext {
+            __m128i rk[15];
+            __m128i h1, h2, h3, h4;
+        };
+
+        AESNI_TARGET inline void loadContext(const AeadKey& key, AesNiContext& ctx) {
+            for (int i = 0; i < 15; ++i) {
+                ctx.rk[i] = _mm_load_si128((const __m128i*)key.aesRoundKeys[i]);
+            }
+            ctx.h1 = _mm_load_si128((const __m128i*)key.ghashPowers[0]);
+            ctx.h2 = _mm_load_si128((const __m128i*)key.ghashPowers[1]);
+            ctx.h3 = _mm_load_si128((const __m128i*)key.ghashPowers[2]);
+            ctx.h4 = _mm_load_si128((const __m128i*)key.ghashPowers[3]);
+        }
+
+        AESNI_TARGET inline __m128i aesEncrypt(const AesNiContext& ctx, __m128i block) {
+            block = _mm_xor_si128(block, ctx.rk[0]);
+            for (int r = 1; r < 14; ++r) {
+                block = _mm_aesenc_si128(block, ctx.rk[r]);
+            }
+            return _mm_aesenclast_si128(block, ctx.rk[14]);
+        }
+
+        AESNI_TARGET inline void aesEncrypt4(const AesNiContext& ctx, __m128i& b0, __m128i& b1, __m128i& b2, __m128i& b3) {
+            b0 = _mm_xor_si128(b0, ctx.rk[0]);
+            b1 = _mm_xor_si128(b1, ctx.rk[0]);
+            b2 = _mm_xor_si128(b2, ctx.rk[0]);
+            b3 = _mm_xor_si128(b3, ctx.rk[0]);
+            for (int r = 1; r < 14; ++r) {
+                b0 = _mm_aesenc_si128(b0, ctx.rk[r]);
+                b1 = _mm_aesenc_si128(b1, ctx.rk[r]);
+                b2 = _mm_aesenc_si128(b2, ctx.rk[r]);
+                b3 = _mm_aesenc_si128(b3, ctx.rk[r]);
+            }
+            b0 = _mm_aesenclast_si128(b0, ctx.rk[14]);
+            b1 = _mm_aesenclast_si128(b1, ctx.rk[14]);
+            b2 = _mm_aesenclast_si128(b2, ctx.rk[14]);
+            b3 = _mm_aesenclast_si128(b3, ctx.rk[14]);
+        }
+
+        // Acumula quatro blocos de uma vez: X = (X ^ c0)H^4 ^ c1 H^3 ^ c2 H^2 ^ c3 H
+        AESNI_TARGET inline __m128i ghash4(const AesNiContext& ctx, __m128i x, __m128i c0, __m128i c1, __m128i c2, __m128i c3) {
+            __m128i p0 = gfMultiplyClmul(_mm_xor_si128(x, byteSwap(c0)), ctx.h4);
+            __m128i p1 = gfMultiplyClmul(byteSwap(c1), ctx.h3);
+            __m128i p2 = gfMultiplyClmul(byteSwap(c2), ctx.h2);
+            __m128i p3 = gfMultiplyClmul(byteSwap(c3), ctx.h1);
+            return _mm_xor_si128(_mm_xor_si128(p0, p1), _mm_xor_si128(p2, p3));
+        }
+
+        AESNI_TARGET inline __m128i ghashTail(const AesNiContext& ctx, __m128i x, const uint8_t* data, size_t length) {
+            while (length > 0) {
+                uint8_t block[16] = {0};
+                size_t take = length < 16 ? length : 16;
+                memcpy(block, data, take);
+                x = gfMultiplyClmul(_mm_xor_si128(x, byteSwap(_mm_loadu_si128((const __m128i*)block))), ctx.h1);
+                data += take;
+                length -= take;
+            }
+            return x;
+        }
+
+        AESNI_TARGET inline __m128i counterAt(__m128i base, uint32_t counter) {
+            return _mm_insert_epi32(base, (int)__builtin_bswap32(counter), 3);
+        }
+
+        // Cifra (encrypt = true) ou decifra e calcula a tag sobre o ciphertext em uma passada
+        AESNI_TARGET void aesNiGcm(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                                   const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, bool encrypt) {
+            AesNiContext ctx;
+            loadContext(key, ctx);
+
+            uint8_t j0Bytes[16];
+            counterBlock(nonce, 1, j0Bytes);
+            __m128i base = _mm_loadu_si128((const __m128i*)j0Bytes);
+
+            __m128i x = ghashTail(ctx, _mm_setzero_si128(), aad, aadLength);
+
+            uint32_t counter = 2;
+            size_t offset = 0;
+            for (; offset + 64 <= length; offset += 64, counter += 4) {
+                __m128i k0 = counterAt(base, counter);
+                __m128i k1 = counterAt(base, counter + 1);
+                __m128i k2 = counterAt(base, counter + 2);
+                __m128i k3 = counterAt(base, counter + 3);
+                aesEncrypt4(ctx, k0, k1, k2, k3);
+
+                const __m128i* src = (const __m128i*)(in + offset);
+                __m128i i0 = _mm_loadu_si128(src), i1 = _mm_loadu_si128(src + 1);
+                __m128i i2 = _mm_loadu_si128(src + 2), i3 = _mm_loadu_si128(src + 3);
+                __m128i o0 = _mm_xor_si128(i0, k0), o1 = _mm_xor_si128(i1, k1);
+                __m128i o2 = _mm_xor_si128(i2, k2), o3 = _mm_xor_si128(i3, k3);
+                __m128i* dst = (__m128i*)(out + offset);
+                _mm_storeu_si128(dst, o0);
+                _mm_storeu_si128(dst + 1, o1);
+                _mm_storeu_si128(dst + 2, o2);
+                _mm_storeu_si128(dst + 3, o3);
+
+                x = encrypt ? ghash4(ctx, x, o0, o1, o2, o3) : ghash4(ctx, x, i0, i1, i2, i3);
+            }
+            for (; offset < length; offset += 16, ++counter) {
+                size_t take = length - offset < 16 ? length - offset : 16;
+                uint8_t stream[16], block[16] = {0};
+                _mm_storeu_si128((__m128i*)stream, aesEncrypt(ctx, counterAt(base, counter)));
+                memcpy(block, in + offset, take);
+                if (!encrypt) {
+                    x = ghashTail(ctx, x, block, take);
+                }
+                for (size_t i = 0; i < take; ++i) {
+                    out[offset + i] = block[i] ^ stream[i];
+                }
+                if (encrypt) {
+                    x = ghashTail(ctx, x, out + offset, take);
+                }
+            }
+
+            __m128i lengths = _mm_set_epi64x((long long)aadLength * 8, (long long)length * 8);
+            x = gfMultiplyClmul(_mm_xor_si128(x, lengths), ctx.h1);
+            __m128i t = _mm_xor_si128(byteSwap(x), aesEncrypt(ctx, base));
+            _mm_storeu_si128((__m128i*)tag, t);
+        }
+#endif
+    }
+
+    void aesGcmInit(AeadKey& key, bool clmul) {
+        expandKey(key.bytes, key.aesRoundKeys);
+        uint8_t zero[16] = {0};
+        encryptBlock(key.aesRoundKeys, zero, key.ghashKey);
+#ifdef AEAD_X86
+        if (clmul) {
+            clmulPowers(key);
+        }
+#else
+        (void)clmul;
+#endif
+    }
+
+    void aesGcmSeal(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, bool aesni) {
+#ifdef AEAD_X86
+        if (aesni) {
+            aesNiGcm(key, nonce, aad, aadLength, in, length, out, tag, true);
+            return;
+        }
+#endif
+        portableCtr(key, nonce, in, length, out);
+        portableTag(key, nonce, aad, aadLength, out, length, tag);
+    }
+
+    void aesGcmOpen(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                    const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, bool aesni) {
+#ifdef AEAD_X86
+        if (aesni) {
+            aesNiGcm(key, nonce, aad, aadLength, in, length, out, tag, false);
+            return;
+        }
+#endif
+        portableTag(key, nonce, aad, aadLength, in, length, tag);
+        portableCtr(key, nonce, in, length, out);
+    }
+}
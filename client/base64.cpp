@@ -0,0 +1,313 @@
+#include "base64.h"
+#include "cpufeatures.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE64_X86 1
+#endif
+
+namespace CryptoUtils {
+
+    namespace {
+        constexpr char ALPHABET[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+            "abcdefghijklmnopqrstuvwxyz"
+            "0123456789+/";
+
+        const uint8_t INVALID = 0xff;
+
+        constexpr std::array<uint8_t, 256> makeDecodeTable() {
+            std::array<uint8_t, 256> table{};
+            for (auto& entry : table) {
+                entry = INVALID;
+            }
+            for (int i = 0; i < 64; ++i) {
+                table[(uint8_t)ALPHABET[i]] = (uint8_t)i;
+            }
+            return table;
+        }
+
+        // Montada em tempo de compilação, em vez de um vetor novo a cada chamada
+        constexpr std::array<uint8_t, 256> DECODE_TABLE = makeDecodeTable();
+
+        size_t encodeScalar(const uint8_t* in, size_t length, char* out) {
+            char* start = out;
+            size_t i = 0;
+            for (; i + 3 <= length; i += 3) {
+                uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+                out[0] = ALPHABET[v >> 18];
+                out[1] = ALPHABET[(v >> 12) & 0x3f];
+                out[2] = ALPHABET[(v >> 6) & 0x3f];
+                out[3] = ALPHABET[v & 0x3f];
+                out += 4;
+            }
+            if (length - i == 1) {
+                uint32_t v = (uint32_t)in[i] << 16;
+                out[0] = ALPHABET[v >> 18];
+                out[1] = ALPHABET[(v >> 12) & 0x3f];
+                out[2] = '=';
+                out[3] = '=';
+                out += 4;
+            } else if (length - i == 2) {
+                uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8;
+                out[0] = ALPHABET[v >> 18];
+                out[1] = ALPHABET[(v >> 12) & 0x3f];
+                out[2] = ALPHABET[(v >> 6) & 0x3f];
+                out[3] = '=';
+                out += 4;
+            }
+            return out - start;
+        }
+
+        // Grupos completos (sem '='); retorna false no primeiro caractere inválido
+        bool decodeScalar(const uint8_t* in, size_t length, uint8_t* out) {
+            for (size_t i = 0; i < length; i += 4) {
+                uint32_t a = DECODE_TABLE[in[i]], b = DECODE_TABLE[in[i + 1]];
+                uint32_t c = DECODE_TABLE[in[i + 2]], d = DECODE_TABLE[in[i + 3]];
+                if ((a | b | c | d) & 0x80) {  // INVALID tem o bit alto ligado
+                    return false;
+                }
+                uint32_t v = a << 18 | b << 12 | c << 6 | d;
+                out[0] = (uint8_t)(v >> 16);
+                out[1] = (uint8_t)(v >> 8);
+                out[2] = (uint8_t)v;
+                out += 3;
+            }
+            return true;
+        }
+
+#ifdef BASE64_X86
+        // ====================================================================
+        // SSSE3 (12 -> 16 bytes) e AVX2 (24 -> 32 bytes), no esquema de Muła e Lemire:
+        // pshufb espalha os bytes, multiplicações separam os índices de 6 bits e uma
+        // tabela de 16 entradas converte índice em ASCII (e ASCII em índice, validando).
+        // Os laços só avançam enquanto sobra entrada para a leitura larga e espaço para
+        // a escrita larga; o resto fica para o escalar.
+        // ====================================================================
+
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+        // 16 bytes com 12 úteis em a b c -> índices de 6 bits, um por byte
+        SSSE3_TARGET inline __m128i encodeIndices(__m128i in) {
+            in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+            __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+            __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+            __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            return _mm_or_si128(t1, t3);
+        }
+
+        SSSE3_TARGET inline __m128i indicesToAscii(__m128i indices) {
+            const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                   '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                   '/' - 63, 'A', 0, 0);
+            __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+            __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+            reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+            return _mm_add_epi8(_mm_shuffle_epi8(shiftLut, reduced), indices);
+        }
+
+        SSSE3_TARGET size_t encodeSsse3(const uint8_t* in, size_t length, char* out) {
+            size_t i = 0;
+            for (; i + 16 <= length; i += 12) {
+                __m128i data = _mm_loadu_si128((const __m128i*)(in + i));
+                _mm_storeu_si128((__m128i*)(out + i / 3 * 4), indicesToAscii(encodeIndices(data)));
+            }
+            return i;
+        }
+
+        AVX2_TARGET size_t encodeAvx2(const uint8_t* in, size_t length, char* out) {
+            const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+            const __m256i shiftLut = _mm256_setr_epi8(
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+            size_t i = 0;
+            for (; i + 28 <= length; i += 24) {
+                // Cada lane de 128 bits recebe 12 bytes úteis
+                __m128i low = _mm_loadu_si128((const __m128i*)(in + i));
+                __m128i high = _mm_loadu_si128((const __m128i*)(in + i + 12));
+                __m256i data = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+                data = _mm256_shuffle_epi8(data, shuffle);
+                __m256i t0 = _mm256_and_si256(data, _mm256_set1_epi32(0x0fc0fc00));
+                __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+                __m256i t2 = _mm256_and_si256(data, _mm256_set1_epi32(0x003f03f0));
+                __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+                __m256i indices = _mm256_or_si256(t1, t3);
+
+                __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+                __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+                reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+                __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, reduced), indices);
+                _mm256_storeu_si256((__m256i*)(out + i / 3 * 4), ascii);
+            }
+            return i;
+        }
+
+        // ASCII -> índices de 6 bits; 'valid' fica false se algum byte não é do alfabeto
+        SSSE3_TARGET inline __m128i decodeIndices(__m128i text, bool& valid) {
+            const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+            const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+            const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i mask2f = _mm_set1_epi8(0x2f);
+            __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(text, 4), mask2f);
+            __m128i loNibbles = _mm_and_si128(text, mask2f);
+            __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+            __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+            valid = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) == 0xffff;
+            __m128i eq2f = _mm_cmpeq_epi8(text, mask2f);
+            __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2f, hiNibbles));
+            return _mm_add_epi8(text, roll);
+        }
+
+        // Junta 4 índices de 6 bits em 3 bytes, 12 bytes úteis no começo do vetor
+        SSSE3_TARGET inline __m128i packIndices(__m128i indices) {
+            __m128i merged = _mm_maddubs_epi16(indices, _mm_set1_epi32(0x01400140));
+            __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+            return _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        }
+
+        // Grava 16 bytes por 12 úteis: exige 8 caracteres além do bloco lido
+        SSSE3_TARGET size_t decodeSsse3(const uint8_t* in, size_t length, uint8_t* out, bool& valid) {
+            size_t i = 0;
+            valid = true;
+            for (; i + 24 <= length; i += 16) {
+                __m128i indices = decodeIndices(_mm_loadu_si128((const __m128i*)(in + i)), valid);
+                if (!valid) {
+                    break;
+                }
+                _mm_storeu_si128((__m128i*)(out + i / 4 * 3), packIndices(indices));
+            }
+            return i;
+        }
+
+        // Grava 32 bytes por 24 úteis: exige 16 caracteres além do bloco lido
+        AVX2_TARGET size_t decodeAvx2(const uint8_t* in, size_t length, uint8_t* out, bool& valid) {
+            const __m256i lutLo = _mm256_setr_epi8(
+                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+            const __m256i lutHi = _mm256_setr_epi8(
+                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+            const __m256i lutRoll = _mm256_setr_epi8(
+                0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i mask2f = _mm256_set1_epi8(0x2f);
+            const __m256i pack = _mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            size_t i = 0;
+            valid = true;
+            for (; i + 48 <= length; i += 32) {
+                __m256i text = _mm256_loadu_si256((const __m256i*)(in + i));
+                __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(text, 4), mask2f);
+                __m256i loNibbles = _mm256_and_si256(text, mask2f);
+                __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+                __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+                if (!_mm256_testz_si256(lo, hi)) {
+                    valid = false;
+                    break;
+                }
+                __m256i eq2f = _mm256_cmpeq_epi8(text, mask2f);
+                __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2f, hiNibbles));
+                __m256i indices = _mm256_add_epi8(text, roll);
+
+                __m256i merged = _mm256_maddubs_epi16(indices, _mm256_set1_epi32(0x01400140));
+                __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+                packed = _mm256_shuffle_epi8(packed, pack);
+                // Junta os 12 bytes de cada lane: 24 contíguos
+                packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+                _mm256_storeu_si256((__m256i*)(out + i / 4 * 3), packed);
+            }
+            return i;
+        }
+#endif
+    }
+
+    size_t base64Encode(const uint8_t* in, size_t length, char* out) {
+        size_t done = 0;
+#ifdef BASE64_X86
+        const CpuFeatures& cpu = cpuFeatures();
+        if (cpu.avx2) {
+            done = encodeAvx2(in, length, out);
+        }
+        if (cpu.ssse3) {
+            done += encodeSsse3(in + done, length - done, out + done / 3 * 4);
+        }
+#endif
+        return done / 3 * 4 + encodeScalar(in + done, length - done, out + done / 3 * 4);
+    }
+
+    bool base64Decode(const char* in, size_t length, uint8_t* out, size_t& outLength) {
+        outLength = 0;
+        if (length % 4 != 0) {
+            return false;
+        }
+        size_t padding = 0;
+        if (length > 0 && in[length - 1] == '=') padding++;
+        if (length > 1 && in[length - 2] == '=') padding++;
+
+        uint8_t* start = out;
+        const uint8_t* s = (const uint8_t*)in;
+        size_t full = padding ? length - 4 : length;
+        size_t done = 0;
+#ifdef BASE64_X86
+        const CpuFeatures& cpu = cpuFeatures();
+        bool valid = true;
+        if (cpu.avx2) {
+            done = decodeAvx2(s, full, out, valid);
+        }
+        if (valid && cpu.ssse3) {
+            done += decodeSsse3(s + done, full - done, out + done / 4 * 3, valid);
+        }
+        if (!valid) {
+            return false;
+        }
+#endif
+        if (!decodeScalar(s + done, full - done, out + done / 4 * 3)) {
+            return false;
+        }
+        out += full / 4 * 3;
+
+        if (padding) {
+            // Último grupo: "xx==" ou "xxx="
+            uint32_t a = DECODE_TABLE[s[full]], b = DECODE_TABLE[s[full + 1]];
+            uint32_t c = padding == 1 ? DECODE_TABLE[s[full + 2]] : 0;
+            if ((a | b | c) & 0x80) {
+                return false;
+            }
+            // Bits que sobram antes do '=' têm que ser zero (só uma codificação por valor)
+            if ((padding == 2 && (b & 0x0f)) || (padding == 1 && (c & 0x03))) {
+                return false;
+            }
+            uint32_t v = a << 18 | b << 12 | c << 6;
+            *out++ = (uint8_t)(v >> 16);
+            if (padding == 1) {
+                *out++ = (uint8_t)(v >> 8);
+            }
+        }
+        outLength = out - start;
+        return true;
+    }
+
+    std::string base64Encode(const std::string& in) {
+        std::string out(base64EncodedLength(in.size()), '\0');
+        base64Encode((const uint8_t*)in.data(), in.size(), &out[0]);
+        return out;
+    }
+
+    bool base64Decode(const std::string& in, std::string& out) {
+        out.resize(base64DecodedMaxLength(in.size()));
+        size_t length;
+        bool ok = base64Decode(in.data(), in.size(), (uint8_t*)&out[0], length);
+        out.resize(ok ? length : 0);
+        return ok;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Base64 (RFC 4648, alfabeto padrão, com '=') sobre buffers do chamador: nada aqui aloca.
+namespace CryptoUtils {
+
+    // Tamanho exato da saída de base64Encode
+    constexpr size_t base64EncodedLength(size_t length) { return (length + 2) / 3 * 4; }
+
+    // Limite superior da saída de base64Decode (o '=' final reduz o tamanho real)
+    constexpr size_t base64DecodedMaxLength(size_t length) { return length / 4 * 3; }
+
+    /**
+     * @brief Codifica 'length' bytes em 'out' (base64EncodedLength(length) bytes) e
+     * retorna quantos escreveu. A entrada pode estar no fim do próprio 'out'
+     * (in == out + base64EncodedLength(length) - length): cada grupo é lido antes
+     * de ser sobrescrito.
+     */
+    size_t base64Encode(const uint8_t* in, size_t length, char* out);
+
+    /**
+     * @brief Decodifica em 'out' (base64DecodedMaxLength(length) bytes; pode ser o
+     * próprio 'in'). Estrito: rejeita tamanho que não é múltiplo de 4, caracteres fora
+     * do alfabeto e '=' fora do final.
+     */
+    bool base64Decode(const char* in, size_t length, uint8_t* out, size_t& outLength);
+
+    std::string base64Encode(const std::string& in);
+    bool base64Decode(const std::string& in, std::string& out);
+}
@@ -0,0 +1,371 @@
+#include "aeadbackends.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AEAD_X86 1
+#endif
+
+namespace CryptoUtils {
+
+    namespace {
+
+        using u128 = unsigned __int128;
+
+        inline uint32_t load32(const uint8_t* p) {
+            return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+
+        inline uint64_t load64(const uint8_t* p) {
+            return (uint64_t)load32(p) | (uint64_t)load32(p + 4) << 32;
+        }
+
+        inline void store64(uint8_t* p, uint64_t v) {
+            for (int i = 0; i < 8; ++i) {
+                p[i] = (uint8_t)(v >> (8 * i));
+            }
+        }
+
+        inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+        // Estado inicial do ChaCha20 (RFC 8439): constantes, chave, contador e nonce
+        void initialState(uint32_t state[16], const uint8_t* key, uint32_t counter, const uint8_t* nonce) {
+            state[0] = 0x61707865;
+            state[1] = 0x3320646e;
+            state[2] = 0x79622d32;
+            state[3] = 0x6b206574;
+            for (int i = 0; i < 8; ++i) {
+                state[4 + i] = load32(key + 4 * i);
+            }
+            state[12] = counter;
+            for (int i = 0; i < 3; ++i) {
+                state[13 + i] = load32(nonce + 4 * i);
+            }
+        }
+
+#define QUARTER_ROUND(a, b, c, d)        \
+        a += b; d ^= a; d = rotl(d, 16); \
+        c += d; b ^= c; b = rotl(b, 12); \
+        a += b; d ^= a; d = rotl(d, 8);  \
+        c += d; b ^= c; b = rotl(b, 7);
+
+        void chachaBlock(const uint32_t state[16], uint8_t out[64]) {
+            uint32_t x[16];
+            memcpy(x, state, sizeof(x));
+            for (int i = 0; i < 10; ++i) {
+                QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+                QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+                QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+                QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+                QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+                QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+                QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+                QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) {
+                uint32_t v = x[i] + state[i];
+                out[4 * i] = (uint8_t)v;
+                out[4 * i + 1] = (uint8_t)(v >> 8);
+                out[4 * i + 2] = (uint8_t)(v >> 16);
+                out[4 * i + 3] = (uint8_t)(v >> 24);
+            }
+        }
+
+        // XOR com o keystream a partir de state[12], um bloco por vez; avança o contador
+        void chachaScalar(uint32_t state[16], const uint8_t* in, size_t length, uint8_t* out) {
+            uint8_t stream[64];
+            for (size_t offset = 0; offset < length; offset += 64) {
+                chachaBlock(state, stream);
+                state[12]++;
+                size_t take = length - offset < 64 ? length - offset : 64;
+                for (size_t i = 0; i < take; ++i) {
+                    out[offset + i] = in[offset + i] ^ stream[i];
+                }
+            }
+        }
+
+#ifdef AEAD_X86
+        // ====================================================================
+        // SSE2 (4 blocos) e AVX2 (8 blocos): cada lane de um vetor é um bloco
+        // diferente; no fim os lanes são transpostos de volta para bytes
+        // ====================================================================
+
+        inline __m128i rotl128(__m128i x, int n) {
+            return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+        }
+
+#define QUARTER_ROUND_SSE(a, b, c, d)                                    \
+        a = _mm_add_epi32(a, b); d = rotl128(_mm_xor_si128(d, a), 16); \
+        c = _mm_add_epi32(c, d); b = rotl128(_mm_xor_si128(b, c), 12); \
+        a = _mm_add_epi32(a, b); d = rotl128(_mm_xor_si128(d, a), 8);  \
+        c = _mm_add_epi32(c, d); b = rotl128(_mm_xor_si128(b, c), 7);
+
+        // Processa blocos de 256 bytes; o resto fica para o escalar
+        size_t chachaSse2(uint32_t state[16], const uint8_t* in, size_t length, uint8_t* out) {
+            size_t done = 0;
+            for (; done + 256 <= length; done += 256) {
+                __m128i s[16], x[16];
+                for (int i = 0; i < 16; ++i) {
+                    s[i] = _mm_set1_epi32((int)state[i]);
+                }
+                s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+                memcpy(x, s, sizeof(x));
+                for (int i = 0; i < 10; ++i) {
+                    QUARTER_ROUND_SSE(x[0], x[4], x[8], x[12]);
+                    QUARTER_ROUND_SSE(x[1], x[5], x[9], x[13]);
+                    QUARTER_ROUND_SSE(x[2], x[6], x[10], x[14]);
+                    QUARTER_ROUND_SSE(x[3], x[7], x[11], x[15]);
+                    QUARTER_ROUND_SSE(x[0], x[5], x[10], x[15]);
+                    QUARTER_ROUND_SSE(x[1], x[6], x[11], x[12]);
+                    QUARTER_ROUND_SSE(x[2], x[7], x[8], x[13]);
+                    QUARTER_ROUND_SSE(x[3], x[4], x[9], x[14]);
+                }
+                for (int i = 0; i < 16; ++i) {
+                    x[i] = _mm_add_epi32(x[i], s[i]);
+                }
+                // Transpõe cada grupo de 4 palavras: 16 bytes de cada um dos 4 blocos
+                for (int g = 0; g < 4; ++g) {
+                    __m128i t0 = _mm_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+                    __m128i t1 = _mm_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+                    __m128i t2 = _mm_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+                    __m128i t3 = _mm_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+                    __m128i lanes[4] = {
+                        _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+                        _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3),
+                    };
+                    for (int b = 0; b < 4; ++b) {
+                        size_t at = done + 64 * b + 16 * g;
+                        __m128i data = _mm_loadu_si128((const __m128i*)(in + at));
+                        _mm_storeu_si128((__m128i*)(out + at), _mm_xor_si128(data, lanes[b]));
+                    }
+                }
+                state[12] += 4;
+            }
+            return done;
+        }
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+        AVX2_TARGET inline __m256i rotl256(__m256i x, int n) {
+            return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+        }
+
+        // Rotações de 16 e 8 bits são permutações de bytes
+        AVX2_TARGET inline __m256i rotl256by16(__m256i x) {
+            return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                                          13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+        }
+
+        AVX2_TARGET inline __m256i rotl256by8(__m256i x) {
+            return _mm256_shuffle_epi8(x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                                          14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+        }
+
+#define QUARTER_ROUND_AVX2(a, b, c, d)                                         \
+        a = _mm256_add_epi32(a, b); d = rotl256by16(_mm256_xor_si256(d, a)); \
+        c = _mm256_add_epi32(c, d); b = rotl256(_mm256_xor_si256(b, c), 12); \
+        a = _mm256_add_epi32(a, b); d = rotl256by8(_mm256_xor_si256(d, a));  \
+        c = _mm256_add_epi32(c, d); b = rotl256(_mm256_xor_si256(b, c), 7);
+
+        // Transpõe 8 vetores de 8 palavras: lane b de x[0..7] vira a linha b
+        AVX2_TARGET inline void transpose8(__m256i x[8], __m256i rows[8]) {
+            __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]), t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+            __m256i t2 = _mm256_unpacklo_epi32(x[2], x[3]), t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+            __m256i t4 = _mm256_unpacklo_epi32(x[4], x[5]), t5 = _mm256_unpackhi_epi32(x[4], x[5]);
+            __m256i t6 = _mm256_unpacklo_epi32(x[6], x[7]), t7 = _mm256_unpackhi_epi32(x[6], x[7]);
+            __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+            __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+            __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+            __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+            rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+            rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+            rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+            rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+            rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+            rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+            rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+            rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+        }
+
+        // Processa blocos de 512 bytes; o resto fica para os caminhos menores
+        AVX2_TARGET size_t chachaAvx2(uint32_t state[16], const uint8_t* in, size_t length, uint8_t* out) {
+            size_t done = 0;
+            for (; done + 512 <= length; done += 512) {
+                __m256i s[16], x[16];
+                for (int i = 0; i < 16; ++i) {
+                    s[i] = _mm256_set1_epi32((int)state[i]);
+                }
+                s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+                for (int i = 0; i < 16; ++i) {
+                    x[i] = s[i];
+                }
+                for (int i = 0; i < 10; ++i) {
+                    QUARTER_ROUND_AVX2(x[0], x[4], x[8], x[12]);
+                    QUARTER_ROUND_AVX2(x[1], x[5], x[9], x[13]);
+                    QUARTER_ROUND_AVX2(x[2], x[6], x[10], x[14]);
+                    QUARTER_ROUND_AVX2(x[3], x[7], x[11], x[15]);
+                    QUARTER_ROUND_AVX2(x[0], x[5], x[10], x[15]);
+                    QUARTER_ROUND_AVX2(x[1], x[6], x[11], x[12]);
+                    QUARTER_ROUND_AVX2(x[2], x[7], x[8], x[13]);
+                    QUARTER_ROUND_AVX2(x[3], x[4], x[9], x[14]);
+                }
+                for (int i = 0; i < 16; ++i) {
+                    x[i] = _mm256_add_epi32(x[i], s[i]);
+                }
+                __m256i low[8], high[8];
+                transpose8(x, low);       // Palavras 0..7 de cada bloco
+                transpose8(x + 8, high);  // Palavras 8..15
+                for (int b = 0; b < 8; ++b) {
+                    const __m256i* src = (const __m256i*)(in + done + 64 * b);
+                    __m256i* dst = (__m256i*)(out + done + 64 * b);
+                    _mm256_storeu_si256(dst, _mm256_xor_si256(_mm256_loadu_si256(src), low[b]));
+                    _mm256_storeu_si256(dst + 1, _mm256_xor_si256(_mm256_loadu_si256(src + 1), high[b]));
+                }
+                state[12] += 8;
+            }
+            return done;
+        }
+#endif
+
+        void chachaXor(uint32_t state[16], const uint8_t* in, size_t length, uint8_t* out, ChaChaBackend backend) {
+            size_t done = 0;
+#ifdef AEAD_X86
+            if (backend == ChaChaBackend::Avx2) {
+                done += chachaAvx2(state, in, length, out);
+            }
+            if (backend != ChaChaBackend::Scalar) {
+                done += chachaSse2(state, in + done, length - done, out + done);
+            }
+#else
+            (void)backend;
+#endif
+            chachaScalar(state, in + done, length - done, out + done);
+        }
+
+        // ====================================================================
+        // Poly1305 com limbs de 44 bits e produtos de 128 bits
+        // ====================================================================
+
+        const uint64_t MASK44 = 0xfffffffffffULL;
+        const uint64_t MASK42 = 0x3ffffffffffULL;
+
+        struct Poly1305 {
+            uint64_t r0, r1, r2, h0 = 0, h1 = 0, h2 = 0, pad0, pad1;
+
+            explicit Poly1305(const uint8_t key[32]) {
+                uint64_t t0 = load64(key), t1 = load64(key + 8);
+                r0 = t0 & 0xffc0fffffffULL;
+                r1 = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+                r2 = (t1 >> 24) & 0x00ffffffc0fULL;
+                pad0 = load64(key + 16);
+                pad1 = load64(key + 24);
+            }
+
+            void block(const uint8_t* m, uint64_t hibit) {
+                uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+                uint64_t t0 = load64(m), t1 = load64(m + 8);
+                h0 += t0 & MASK44;
+                h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+                h2 += (((t1 >> 24)) & MASK42) | hibit;
+
+                u128 d0 = (u128)h0 * r0 + (u128)h1 * s2 + (u128)h2 * s1;
+                u128 d1 = (u128)h0 * r1 + (u128)h1 * r0 + (u128)h2 * s2;
+                u128 d2 = (u128)h0 * r2 + (u128)h1 * r1 + (u128)h2 * r0;
+
+                uint64_t c = (uint64_t)(d0 >> 44); h0 = (uint64_t)d0 & MASK44;
+                d1 += c; c = (uint64_t)(d1 >> 44); h1 = (uint64_t)d1 & MASK44;
+                d2 += c; c = (uint64_t)(d2 >> 42); h2 = (uint64_t)d2 & MASK42;
+                h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+                h1 += c;
+            }
+
+            // Dados completados com zeros até 16 bytes, como o AEAD da RFC 8439 pede
+            void update(const uint8_t* data, size_t length) {
+                for (; length >= 16; data += 16, length -= 16) {
+                    block(data, 1ULL << 40);
+                }
+                if (length > 0) {
+                    uint8_t last[16] = {0};
+                    memcpy(last, data, length);
+                    block(last, 1ULL << 40);
+                }
+            }
+
+            void finish(uint8_t mac[16]) {
+                uint64_t c = h1 >> 44; h1 &= MASK44;
+                h2 += c; c = h2 >> 42; h2 &= MASK42;
+                h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+                h1 += c; c = h1 >> 44; h1 &= MASK44;
+                h2 += c; c = h2 >> 42; h2 &= MASK42;
+                h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+                h1 += c;
+
+                // h - p, escolhido sem desvio se não ficar negativo
+                uint64_t g0 = h0 + 5; c = g0 >> 44; g0 &= MASK44;
+                uint64_t g1 = h1 + c; c = g1 >> 44; g1 &= MASK44;
+                uint64_t g2 = h2 + c - (1ULL << 42);
+                c = (g2 >> 63) - 1;
+                g0 &= c; g1 &= c; g2 &= c;
+                c = ~c;
+                h0 = (h0 & c) | g0;
+                h1 = (h1 & c) | g1;
+                h2 = (h2 & c) | g2;
+
+                h0 += pad0 & MASK44; c = h0 >> 44; h0 &= MASK44;
+                h1 += (((pad0 >> 44) | (pad1 << 20)) & MASK44) + c; c = h1 >> 44; h1 &= MASK44;
+                h2 += ((pad1 >> 24) & MASK42) + c; h2 &= MASK42;
+
+                store64(mac, h0 | (h1 << 44));
+                store64(mac + 8, (h1 >> 20) | (h2 << 24));
+            }
+        };
+
+        void computeTag(const uint8_t polyKey[32], const uint8_t* aad, size_t aadLength,
+                        const uint8_t* ciphertext, size_t length, uint8_t* tag) {
+            Poly1305 poly(polyKey);
+            poly.update(aad, aadLength);
+            poly.update(ciphertext, length);
+            uint8_t lengths[16];
+            store64(lengths, aadLength);
+            store64(lengths + 8, length);
+            poly.update(lengths, sizeof(lengths));
+            poly.finish(tag);
+        }
+
+        // Bloco 0 gera a chave do Poly1305; a mensagem usa os blocos a partir do 1
+        void polyKeyAndState(const AeadKey& key, const uint8_t* nonce, uint8_t polyKey[32], uint32_t state[16]) {
+            initialState(state, key.bytes, 0, nonce);
+            uint8_t block0[64];
+            chachaBlock(state, block0);
+            memcpy(polyKey, block0, 32);
+            state[12] = 1;
+        }
+    }
+
+    void chachaPolySeal(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                        const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, ChaChaBackend backend) {
+        uint8_t polyKey[32];
+        uint32_t state[16];
+        polyKeyAndState(key, nonce, polyKey, state);
+        chachaXor(state, in, length, out, backend);
+        computeTag(polyKey, aad, aadLength, out, length, tag);
+    }
+
+    void chachaPolyOpen(const AeadKey& key, const uint8_t* nonce, const uint8_t* aad, size_t aadLength,
+                        const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag, ChaChaBackend backend) {
+        uint8_t polyKey[32];
+        uint32_t state[16];
+        polyKeyAndState(key, nonce, polyKey, state);
+        computeTag(polyKey, aad, aadLength, in, length, tag);
+        chachaXor(state, in, length, out, backend);
+    }
+
+    void chacha20Stream(const uint8_t key[32], const uint8_t nonce[12], uint32_t counter,
+                        uint8_t* out, size_t length, ChaChaBackend backend) {
+        uint32_t state[16];
+        initialState(state, key, counter, nonce);
+        memset(out, 0, length);
+        chachaXor(state, out, length, out, backend);
+    }
+}
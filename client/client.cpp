@@ -1,12 +1,73 @@
 #include "client.h"
+#include "aead.h"
+#include "base64.h"
+#include "csprng.h"
+#include <cstdio>
 #include <cstring>
 #include <map>
 // TESTES e PREGUIÇA
 #include <cmath>
 
 const int MESSAGE_BUFFER_SIZE = 4096;
+// Tempo que a chave da época anterior continua aceita depois de uma troca de chaves
+const chrono::milliseconds KEY_GRACE_PERIOD(10000);
+const chrono::milliseconds HEARTBEAT_INTERVAL(5000);
+const int MAX_MISSED_HEARTBEATS = 3;
+const size_t RTT_WINDOW = 8;  // Amostras usadas na média móvel do RTT
+const ull HISTORY_PAGE = 50;  // Mensagens pedidas por /history
+const chrono::milliseconds RECONNECT_BACKOFF_MIN(250);
+const chrono::milliseconds RECONNECT_BACKOFF_MAX(4000);
 
-Client::Client(const char *serverIp, int port, UIManager &ui) : uiManager(ui), connected(false)
+// Elementos do MODP viajam como número, como sempre viajaram; pontos da curva em base64
+static json groupElementToJson(const string& element)
+{
+    ull value;
+    if (CryptoUtils::modpValue(element, value))
+        return value;
+    return CryptoUtils::base64Encode(element);
+}
+
+static bool groupElementFromJson(const json& value, string& out)
+{
+    if (value.is_number_unsigned()) {
+        out = CryptoUtils::modpElement(value.get<ull>());
+        return true;
+    }
+    return value.is_string() && CryptoUtils::base64Decode(value.get<string>(), out);
+}
+
+// Prova da rodada 1: escalares do MODP como número, os da curva em base64
+static json proofToJson(const CryptoUtils::IntermediateProof& proof)
+{
+    json out;
+    for (const auto& field : {make_pair("c", &proof.c), make_pair("s", &proof.s)}) {
+        const string& bytes = *field.second;
+        if (bytes.size() == 8) {
+            ull value = 0;
+            for (int i = 0; i < 8; ++i)
+                value |= (ull)(uint8_t)bytes[i] << (8 * i);
+            out[field.first] = value;
+        } else {
+            out[field.first] = CryptoUtils::base64Encode(bytes);
+        }
+    }
+    return out;
+}
+
+// Primeiros bytes da chave em hex, para comparar entre clientes sem mostrar a chave
+static string keyFingerprint(const CryptoUtils::GroupKey& key)
+{
+    static const char* digits = "0123456789abcdef";
+    string hex;
+    for (size_t i = 0; i < 8; ++i) {
+        hex.push_back(digits[key[i] >> 4]);
+        hex.push_back(digits[key[i] & 0xf]);
+    }
+    return hex;
+}
+
+Client::Client(const char *serverIp, int port, UIManager &ui, CryptoUtils::KeyGroup keyGroup)
+    : connected(false), uiManager(ui), keyGroup(keyGroup), keyPool(8, keyGroup), missedHeartbeats(0)
 {
     clientSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (clientSocket < 0)
@@ -24,8 +85,9 @@ Client::Client(const char *serverIp, int port, UIManager &ui) : uiManager(ui), c
         clientSocket = -1;
     }
 
-    privateKey = CryptoUtils::generatePrivateKey();
-    publicKey = CryptoUtils::generatePublicKey(privateKey);
+    KeyPool::KeyPair identity = keyPool.take();
+    privateKey = identity.privateKey;
+    publicKey = identity.publicKey;
 }
 
 Client::~Client()
@@ -37,8 +99,18 @@ void Client::stop()
 {
     if (connected)
     {
+        // Saída intencional: o servidor tira o usuário das salas sem esperar retomada
+        json logout;
+        logout["type"] = "C2S_LOGOUT";
+        logout["payload"] = json::object();
+        sendJson(logout);
         connected = false;
     }
+    heartbeatCv.notify_all();
+    if (heartbeatThread.joinable())
+    {
+        heartbeatThread.join();
+    }
     if (receiverThread.joinable())
     {
         receiverThread.join();
@@ -121,12 +193,13 @@ bool Client::connectToServer()
     json j;
     j["type"] = "C2S_AUTHENTICATE_AND_JOIN";
     j["payload"]["username"] = username;
-    j["payload"]["publicKey"] = publicKey;
+    j["payload"]["publicKey"] = groupElementToJson(publicKey);
+    j["payload"]["keyGroup"] = CryptoUtils::keyGroupName(keyGroup);
 
-    string jsonStr = j.dump();
-    uiManager.debugLog(jsonStr);
+    uiManager.debugLog(j.dump());
+    uiManager.debugLog(string("Message cipher: ") + CryptoUtils::aeadBackendName(CryptoUtils::preferredAead()));
 
-    if (!sendAll(clientSocket, jsonStr.c_str(), jsonStr.size()))
+    if (!sendJson(j))
     {
         uiManager.drawMessage("System", "Failed to send user name", Color::Yellow);
         return false;
@@ -143,6 +216,7 @@ void Client::run()
         return;
 
     receiverThread = thread(&Client::receiveMessages, this);
+    heartbeatThread = thread(&Client::sendHeartbeats, this);
 
     while (connected)
     {
@@ -162,6 +236,9 @@ void Client::receiveMessages()
     {
         if (!recvAll(clientSocket, jsonStr))
         {
+            if (connected && resumable && reconnect()) {
+                continue;
+            }
             uiManager.drawMessage("System", "Server disconnected", Color::Yellow);
             connected = false;
             uiManager.updateStatus("Disconnected. Press any key to exit.");
@@ -191,47 +268,141 @@ void Client::receiveMessages()
             
             string type = j.at("type");
 
+            // Qualquer mensagem do servidor prova que a conexão está viva
+            missedHeartbeats = 0;
+
+            // Frames de sala dizem pelo stream a qual delas pertencem
+            Stream* stream = nullptr;
+            if (j.contains("stream") && type != "S2C_ROOM_JOINED") {
+                auto found = streams.find(j.at("stream").get<StreamId>());
+                if (found == streams.end()) {
+                    // Restos de uma sala de que acabamos de sair
+                    uiManager.debugLog("Frame for unknown stream: " + jsonStr);
+                    continue;
+                }
+                stream = &found->second;
+            }
+            bool connectionFrame = type == "PING" || type == "PONG" || type == "S2C_SLOW_DOWN" ||
+                                   type == "S2C_ROOM_JOINED" || type == "S2C_USER_NOTIFICATION" ||
+                                   type == "S2C_SESSION" || type == "S2C_RESUMED" || type == "S2C_RESUME_FAILED";
+            if (!stream && !connectionFrame) {
+                uiManager.debugLog("Room frame without stream: " + jsonStr);
+                continue;
+            }
+
             if (type == "S2C_BROADCAST_GROUP_MESSAGE") {
-                handleMessage(j);
+                handleMessage(*stream, j);
+            }
+            else if (type == "PING") {
+                handlePing(j);
+            }
+            else if (type == "PONG") {
+                handlePong(j);
             }
             else if (type == "S2C_USER_NOTIFICATION") {
-                handleUserNotification(j);
+                handleUserNotification(stream, j);
+            }
+            else if (type == "S2C_SLOW_DOWN") {
+                handleSlowDown(j);
+            }
+            else if (type == "S2C_ROOM_JOINED") {
+                handleRoomJoined(j);
+            }
+            else if (type == "S2C_SESSION") {
+                handleSession(j);
+            }
+            else if (type == "S2C_RESUMED") {
+                handleResumed();
+            }
+            else if (type == "S2C_RESUME_FAILED") {
+                handleResumeFailed(j);
+            }
+            else if (type == "S2C_HISTORY_END") {
+                handleHistoryEnd(*stream, j);
+            }
+            else if (type == "S2C_ROOM_LEFT") {
+                handleRoomLeft(*stream);
             }
             else if (type == "S2C_GROUP_MEMBERS_LIST") {
-                groupMembers.clear();
-                auto members = j.at("payload").at("members");
-                for (const auto& m : members) {
-                    groupMembers.push_back({m.at("username"), m.at("publicKey")});
-                }
-                
-                // Aguarda comando do servidor para iniciar troca de chaves
-                uiManager.drawMessage("System", "Group members updated. Waiting for key exchange...", Color::Gray);
+                applyMembersSnapshot(*stream, j);
+            }
+            else if (type == "S2C_MEMBER_ADDED") {
+                applyMembershipChange(*stream, j, true);
+            }
+            else if (type == "S2C_MEMBER_REMOVED") {
+                applyMembershipChange(*stream, j, false);
             }
             else if (type == "S2C_START_KEY_EXCHANGE_ROUND1") {
                 // Rodada 1: Calcula valor intermediário
-                uiManager.drawMessage("System", "Starting key exchange round 1...", Color::Gray);
+                uiManager.drawMessage(roomLabel(*stream, "System"), "Starting key exchange round 1...", Color::Gray);
+                ull epoch = j.at("payload").value("epochId", 0ULL);
+                {
+                    // Novas mensagens ficam na fila até a época nova ser confirmada
+                    lock_guard<mutex> lock(keyMutex);
+                    stream->keyRing.beginRekey(epoch);
+                }
                 
-                // Encontra índice do usuário atual
-                int myIndex = 0;
-                for (size_t i = 0; i < groupMembers.size(); ++i) {
-                    if (groupMembers[i].id == username) {
-                        myIndex = i;
-                        break;
+                // Anel desta época, na ordem do servidor: cada membro usa o par que anunciou na
+                // troca anterior. Sem a lista (servidor antigo), vale a lista de membros local.
+                stream->exchangeRing.clear();
+                stream->exchangeIndex.clear();
+                if (j.at("payload").contains("publicKeys")) {
+                    for (const auto& entry : j.at("payload").at("publicKeys")) {
+                        CryptoUtils::RingMember member;
+                        member.id = entry.at("username").get<string>();
+                        groupElementFromJson(entry.at("publicKey"), member.publicKey);
+                        stream->exchangeIndex[member.id] = stream->exchangeRing.size();
+                        stream->exchangeRing.push_back(member);
                     }
+                } else {
+                    stream->exchangeRing = stream->groupMembers;
+                    stream->exchangeIndex = stream->memberIndex;
+                }
+
+                // Lista de exibição divergente do anel: pede a lista completa de novo, sem
+                // deixar de participar desta troca
+                bool listMatches = stream->groupMembers.size() == stream->exchangeRing.size();
+                for (size_t i = 0; listMatches && i < stream->exchangeRing.size(); ++i) {
+                    listMatches = stream->memberIndex.count(stream->exchangeRing[i].id) > 0;
+                }
+                if (!listMatches) {
+                    uiManager.debugLog("Member list out of date, resyncing");
+                    stream->groupMembers.clear();
+                    stream->memberIndex.clear();
+                    stream->membershipVersion = 0;
+                    requestMembersSync(*stream);
+                }
+
+                // Índice do usuário atual no anel
+                const auto& groupMembers = stream->exchangeRing;
+                auto self = stream->exchangeIndex.find(username);
+                if (self == stream->exchangeIndex.end()) {
+                    uiManager.drawMessage(roomLabel(*stream, "System"), "Not in this key exchange, skipping round 1", Color::Yellow);
+                    continue;
                 }
+                size_t myIndex = self->second;
+                stream->exchangePrivateKey = exchangeKeyFor(*stream, groupMembers[myIndex].publicKey);
                 
                 // Calcula valor intermediário
                 const auto& before = groupMembers[(myIndex - 1 + groupMembers.size()) % groupMembers.size()];
                 const auto& after = groupMembers[(myIndex + 1) % groupMembers.size()];
-                ull intermediateValue = CryptoUtils::calculateIntermediateValue(privateKey, before, after);
+                string intermediateValue;
+                CryptoUtils::IntermediateProof proof;
+                if (!CryptoUtils::intermediateValue(keyGroup, stream->exchangePrivateKey, groupMembers[myIndex], before, after,
+                                                    epoch, intermediateValue, proof)) {
+                    uiManager.drawMessage(roomLabel(*stream, "System"), "Invalid public key from a neighbour, skipping round 1", Color::Red);
+                    continue;
+                }
                 
                 // Envia valor intermediário para o servidor
                 json round1Msg;
                 round1Msg["type"] = "C2S_INTERMEDIATE_VALUE";
-                round1Msg["payload"]["intermediateValue"] = intermediateValue;
+                round1Msg["stream"] = stream->id;
+                round1Msg["payload"]["intermediateValue"] = groupElementToJson(intermediateValue);
+                round1Msg["payload"]["proof"] = proofToJson(proof);
+                round1Msg["payload"]["epochId"] = epoch;
                 
-                string jsonStr = round1Msg.dump();
-                if (!sendAll(clientSocket, jsonStr.c_str(), jsonStr.size())) {
+                if (!sendJson(round1Msg)) {
                     uiManager.drawMessage("System", "Failed to send intermediate value", Color::Yellow);
                 } else {
                     uiManager.drawMessage("System", "Intermediate value sent to server", Color::Gray);
@@ -239,62 +410,92 @@ void Client::receiveMessages()
             }
             else if (type == "S2C_START_KEY_EXCHANGE_ROUND2") {
                 // Rodada 2: Recebe todos os valores intermediários e calcula chave secreta
-                uiManager.drawMessage("System", "Starting key exchange round 2...", Color::Gray);
+                uiManager.drawMessage(roomLabel(*stream, "System"), "Starting key exchange round 2...", Color::Gray);
+                ull epoch = j.at("payload").value("epochId", 0ULL);
                 
-                // Encontra índice do usuário atual
-                int myIndex = 0;
-                for (size_t i = 0; i < groupMembers.size(); ++i) {
-                    if (groupMembers[i].id == username) {
-                        myIndex = i;
-                        break;
-                    }
+                // Índice do usuário atual no anel da rodada 1
+                const auto& groupMembers = stream->exchangeRing;
+                const auto& memberIndex = stream->exchangeIndex;
+                auto self = memberIndex.find(username);
+                if (self == memberIndex.end()) {
+                    uiManager.drawMessage(roomLabel(*stream, "System"), "Not in this key exchange, skipping round 2", Color::Yellow);
+                    continue;
                 }
+                size_t myIndex = self->second;
                 
                 // Constrói lista de valores intermediários na ordem correta
-                std::vector<ull> intermediateValues(groupMembers.size(), 0);
+                std::vector<string> intermediateValues(groupMembers.size());
                 auto intermediateData = j.at("payload").at("intermediateValues");
                 
                 for (const auto& data : intermediateData) {
                     string memberUsername = data.at("username");
-                    ull memberValue = data.at("intermediateValue").get<ull>();
                     
-                    // Encontra o índice correto deste membro
-                    for (size_t i = 0; i < groupMembers.size(); ++i) {
-                        if (groupMembers[i].id == memberUsername) {
-                            intermediateValues[i] = memberValue;
-                            break;
-                        }
+                    // Coloca o valor na posição deste membro no anel
+                    auto member = memberIndex.find(memberUsername);
+                    if (member != memberIndex.end()) {
+                        groupElementFromJson(data.at("intermediateValue"), intermediateValues[member->second]);
                     }
                 }
                 
                 // Calcula chave secreta compartilhada
-                sharedSecret = CryptoUtils::calculateSharedSecret(
-                    privateKey, myIndex, groupMembers, intermediateValues
-                );
+                const string& exchangeKey = stream->exchangePrivateKey.empty() ? privateKey : stream->exchangePrivateKey;
+                CryptoUtils::GroupKey sharedSecret;
+                if (!CryptoUtils::sharedSecret(keyGroup, exchangeKey, myIndex, groupMembers, intermediateValues, sharedSecret)) {
+                    uiManager.drawMessage(roomLabel(*stream, "System"), "Invalid intermediate values, skipping round 2", Color::Red);
+                    continue;
+                }
+                {
+                    // A chave só passa a ser usada quando o servidor confirmar a época
+                    lock_guard<mutex> lock(keyMutex);
+                    stream->keyRing.setPending(epoch, sharedSecret);
+                }
                 
-                uiManager.drawMessage("System", "Shared secret calculated: " + to_string(sharedSecret), Color::Gray);
+                uiManager.drawMessage(roomLabel(*stream, "System"), "Shared secret calculated for epoch " + to_string(epoch) + ": " + keyFingerprint(sharedSecret), Color::Gray);
                 
                 // Notifica servidor que completou rodada 2
                 json round2Msg;
                 round2Msg["type"] = "C2S_ROUND2_COMPLETED";
+                round2Msg["stream"] = stream->id;
+                round2Msg["payload"]["epochId"] = epoch;
+                round2Msg["payload"]["keyConfirmation"] = CryptoUtils::base64Encode(CryptoUtils::keyConfirmation(sharedSecret, epoch));
+                round2Msg["payload"]["nextPublicKey"] = groupElementToJson(announceNextKey(*stream));
                 
-                string jsonStr = round2Msg.dump();
-                if (!sendAll(clientSocket, jsonStr.c_str(), jsonStr.size())) {
+                if (!sendJson(round2Msg)) {
                     uiManager.drawMessage("System", "Failed to notify round 2 completion", Color::Yellow);
                 }
             }
+            else if (type == "S2C_FAST_JOIN") {
+                handleFastJoin(*stream, j);
+            }
+            else if (type == "S2C_KEY_DELIVERY") {
+                handleKeyDelivery(*stream, j);
+            }
             else if (type == "S2C_KEY_EXCHANGE_COMPLETED") {
-                uiManager.drawMessage("System", "Group key exchange completed successfully!", Color::Gray);
+                ull epoch = j.contains("payload") ? j.at("payload").value("epochId", 0ULL) : 0ULL;
+                lock_guard<mutex> lock(keyMutex);
+                if (stream->keyRing.confirm(epoch)) {
+                    uiManager.drawMessage(roomLabel(*stream, "System"), "Group key exchange completed successfully! Epoch " + to_string(epoch), Color::Gray);
+                    flushOutgoingQueue(*stream);
+                } else {
+                    uiManager.debugLog("Key exchange completion for unknown epoch " + to_string(epoch));
+                }
             }
             else if (type == "S2C_INDIVIDUAL_KEY_RESET") {
                 // Gera nova chave individual quando usuário fica sozinho
                 string message = j.at("payload").at("message");
-                uiManager.drawMessage("System", message, Color::Yellow);
+                uiManager.drawMessage(roomLabel(*stream, "System"), message, Color::Yellow);
                 
                 // Gera nova chave secreta individual (mantém chaves privada/pública inalteradas)
-                sharedSecret = CryptoUtils::generatePrivateKey();
+                ull epoch = j.at("payload").value("epochId", 0ULL);
+                CryptoUtils::GroupKey individualKey;
+                CryptoUtils::randomBytes(individualKey.data(), individualKey.size());
+                {
+                    lock_guard<mutex> lock(keyMutex);
+                    stream->keyRing.install(epoch, individualKey);
+                    flushOutgoingQueue(*stream);
+                }
                 
-                uiManager.drawMessage("System", "New individual key generated: " + to_string(sharedSecret), Color::Gray);
+                uiManager.drawMessage("System", "New individual key generated: " + keyFingerprint(individualKey), Color::Gray);
                 uiManager.drawMessage("System", "Note: Messages will be encrypted with your new individual key", Color::Gray);
             }
             else {
@@ -307,27 +508,502 @@ void Client::receiveMessages()
     }
 }
 
-void Client::handleMessage(const json& j) {
+// Reabre a conexão com backoff exponencial até o fim do prazo de retomada e pede C2S_RESUME
+// com a última sequência e versão da lista de membros de cada sala
+bool Client::reconnect()
+{
+    reconnecting = true;
+    uiManager.drawMessage("System", "Connection lost, reconnecting...", Color::Yellow);
+    uiManager.updateStatus("Reconnecting...");
+
+    auto deadline = chrono::steady_clock::now() + resumeGrace;
+    chrono::milliseconds backoff = RECONNECT_BACKOFF_MIN;
+    while (connected && chrono::steady_clock::now() < deadline) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) == 0) {
+            {
+                lock_guard<mutex> lock(sendMutex);
+                close(clientSocket);
+                clientSocket = fd;
+            }
+            missedHeartbeats = 0;
+
+            json resume;
+            resume["type"] = "C2S_RESUME";
+            resume["payload"]["token"] = resumeToken;
+            resume["payload"]["streams"] = json::array();
+            {
+                lock_guard<mutex> lock(keyMutex);
+                for (const auto& entry : streams) {
+                    json known;
+                    known["stream"] = entry.first;
+                    known["lastSeq"] = entry.second.lastSeq;
+                    known["membershipVersion"] = entry.second.membershipVersion;
+                    resume["payload"]["streams"].push_back(known);
+                }
+            }
+            if (sendJson(resume)) {
+                return true;
+            }
+        } else if (fd >= 0) {
+            close(fd);
+        }
+        this_thread::sleep_for(min(backoff, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now())));
+        backoff = min(backoff * 2, RECONNECT_BACKOFF_MAX);
+    }
+    reconnecting = false;
+    return false;
+}
+
+void Client::handleSession(const json& j)
+{
+    resumeToken = j.at("payload").at("token");
+    resumeGrace = chrono::milliseconds(j.at("payload").value("resumeGraceMs", 0LL));
+    resumable = resumeGrace.count() > 0;
+}
+
+// O servidor manteve as salas e as épocas: só falta enviar o que foi digitado durante a queda
+void Client::handleResumed()
+{
+    reconnecting = false;
+    uiManager.drawMessage("System", "Reconnected.", Color::Yellow);
+    uiManager.updateStatus(statusLine());
+
+    lock_guard<mutex> lock(keyMutex);
+    for (auto& entry : streams) {
+        if (!entry.second.keyRing.isRekeying()) {
+            flushOutgoingQueue(entry.second);
+        }
+    }
+}
+
+// Prazo vencido: entra de novo do zero, só na sala padrão
+void Client::handleResumeFailed(const json& j)
+{
+    string reason = j.at("payload").value("reason", "");
+    {
+        lock_guard<mutex> lock(keyMutex);
+        size_t lost = 0;
+        for (const auto& entry : streams) {
+            lost += entry.second.outgoingQueue.size();
+        }
+        if (lost > 0) {
+            uiManager.drawMessage("System", to_string(lost) + " queued message(s) discarded.", Color::Yellow);
+        }
+        streams.clear();
+        activeStream = 0;
+    }
+    resumable = false;
+    reconnecting = false;
+    uiManager.drawMessage("System", "Could not resume session (" + reason + "), joining again.", Color::Yellow);
+
+    json j2;
+    j2["type"] = "C2S_AUTHENTICATE_AND_JOIN";
+    j2["payload"]["username"] = username;
+    j2["payload"]["publicKey"] = groupElementToJson(publicKey);
+    j2["payload"]["keyGroup"] = CryptoUtils::keyGroupName(keyGroup);
+    sendJson(j2);
+}
+
+static long long nowUs() {
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Client::sendHeartbeats()
+{
+    unique_lock<mutex> lock(heartbeatMutex);
+    while (connected)
+    {
+        heartbeatCv.wait_for(lock, HEARTBEAT_INTERVAL, [this] { return !connected; });
+        if (!connected)
+            break;
+
+        if (reconnecting)
+            continue;
+
+        if (missedHeartbeats >= MAX_MISSED_HEARTBEATS)
+        {
+            // Conexão meio-aberta: derruba o socket para a thread de recepção perceber
+            // (e reconectar, se a sessão puder ser retomada)
+            uiManager.drawMessage("System", "Server stopped answering heartbeats", Color::Yellow);
+            missedHeartbeats = 0;
+            shutdown(clientSocket, SHUT_RDWR);
+            continue;
+        }
+        missedHeartbeats++;
+
+        json ping;
+        ping["type"] = "PING";
+        ping["payload"]["ts"] = nowUs();
+        sendJson(ping);
+    }
+}
+
+void Client::handlePing(const json& j)
+{
+    json pong;
+    pong["type"] = "PONG";
+    pong["payload"]["ts"] = j.at("payload").at("ts");
+    sendJson(pong);
+}
+
+void Client::handlePong(const json& j)
+{
+    long long sentAt = j.at("payload").at("ts").get<long long>();
+    double rttMs = (nowUs() - sentAt) / 1000.0;
+
+    rttSamples.push_back(rttMs);
+    if (rttSamples.size() > RTT_WINDOW)
+        rttSamples.pop_front();
+
+    double sum = 0;
+    for (double sample : rttSamples)
+        sum += sample;
+
+    char rtt[32];
+    snprintf(rtt, sizeof(rtt), "%.1f ms", sum / rttSamples.size());
+    uiManager.updateStatus(statusLine() + "  |  RTT: " + rtt);
+}
+
+// Lista completa: recebida no join ou quando pedimos sincronização
+void Client::applyMembersSnapshot(Stream& stream, const json& j) {
+    stream.groupMembers.clear();
+    auto members = j.at("payload").at("members");
+    for (const auto& m : members) {
+        CryptoUtils::RingMember member{m.at("username"), ""};
+        groupElementFromJson(m.at("publicKey"), member.publicKey);
+        stream.groupMembers.push_back(member);
+    }
+    stream.memberIndex.clear();
+    reindexMembers(stream, 0);
+    stream.membershipVersion = j.at("payload").value("version", 0ULL);
+    stream.membershipSyncPending = false;
+
+    // Aguarda comando do servidor para iniciar troca de chaves
+    uiManager.drawMessage(roomLabel(stream, "System"), "Group members updated. Waiting for key exchange...", Color::Gray);
+}
+
+// Pede ao servidor as versões da lista de membros depois da que temos (uma vez por vez)
+void Client::requestMembersSync(Stream& stream) {
+    if (stream.membershipSyncPending) {
+        return;
+    }
+    stream.membershipSyncPending = true;
+    json sync;
+    sync["type"] = "C2S_SYNC_MEMBERS";
+    sync["stream"] = stream.id;
+    sync["payload"]["version"] = stream.membershipVersion;
+    sendJson(sync);
+}
+
+// Aplica um delta da lista de membros mantendo a mesma ordem do servidor
+void Client::applyMembershipChange(Stream& stream, const json& j, bool added) {
+    ull version = j.at("payload").at("version").get<ull>();
+    if (version <= stream.membershipVersion) {
+        return; // Já aplicado
+    }
+    if (version != stream.membershipVersion + 1) {
+        // Perdemos alguma versão: pede ao servidor o que falta
+        requestMembersSync(stream);
+        return;
+    }
+
+    string memberUsername = j.at("payload").at("username");
+    if (added) {
+        if (!stream.memberIndex.count(memberUsername)) {
+            CryptoUtils::RingMember member{memberUsername, ""};
+            groupElementFromJson(j.at("payload").at("publicKey"), member.publicKey);
+            stream.groupMembers.push_back(member);
+            reindexMembers(stream, stream.groupMembers.size() - 1);
+        }
+    } else {
+        auto found = stream.memberIndex.find(memberUsername);
+        if (found != stream.memberIndex.end()) {
+            size_t position = found->second;
+            stream.memberIndex.erase(found);
+            stream.groupMembers.erase(stream.groupMembers.begin() + position);
+            reindexMembers(stream, position);
+        }
+    }
+    stream.membershipVersion = version;
+    stream.membershipSyncPending = false;
+}
+
+// Recalcula as posições a partir de `first` (quem vem depois de uma saída anda uma casa)
+void Client::reindexMembers(Stream& stream, size_t first) {
+    for (size_t i = first; i < stream.groupMembers.size(); ++i) {
+        stream.memberIndex[stream.groupMembers[i].id] = i;
+    }
+}
+
+void Client::handleMessage(Stream& stream, const json& j) {
     string sender = j.at("payload").at("sender");
-    string message = j.at("payload").at("ciphertext");
+    const string& message = j.at("payload").at("ciphertext").get_ref<const string&>();
+    ull epoch = j.at("payload").value("epochId", 0ULL);
+
+    // Sequências até a última recebida só chegam de novo por /history; fora dele são
+    // duplicatas (ex.: reenviadas na retomada depois de já terem chegado)
+    ull seq = j.at("payload").value("seq", 0ULL);
+    CryptoUtils::GroupKey key;
+    {
+        lock_guard<mutex> lock(keyMutex);
+        if (seq != 0 && seq <= stream.lastSeq) {
+            if (!stream.historyPending) {
+                uiManager.debugLog("Duplicate message #" + to_string(seq) + " dropped");
+                return;
+            }
+            sender += " (history)";
+        } else {
+            stream.lastSeq = max(stream.lastSeq, seq);
+        }
+
+        if (!stream.keyRing.keyFor(epoch, key)) {
+            uiManager.drawMessage(roomLabel(stream, sender), "[message encrypted with unknown key epoch " + to_string(epoch) + "]", Color::Red);
+            return;
+        }
+    }
 
-    string decryptedMessage = CryptoUtils::decryptMessage(message, sharedSecret);
+    // Só a thread de recepção decifra; o buffer cresce até a maior mensagem e é reaproveitado
+    thread_local string decryptedMessage;
+    decryptedMessage.resize(CryptoUtils::decryptedMessageMaxLength(message.size()));
+    size_t length;
+    bool ok = CryptoUtils::decryptMessage(message.data(), message.size(), key, &decryptedMessage[0], length);
+    decryptedMessage.resize(length);
+    if (!ok) {
+        uiManager.drawMessage(roomLabel(stream, sender), "[message failed authentication]", Color::Red);
+        return;
+    }
 
-    uiManager.drawMessage(sender, decryptedMessage, Color::Gray);
+    uiManager.drawMessage(roomLabel(stream, sender), decryptedMessage, Color::Gray);
 }
 
-void Client::handleUserNotification(const json& j) {
+// "rate": o servidor só está segurando nossas mensagens; "overload": a última foi descartada
+void Client::handleSlowDown(const json& j) {
+    string reason = j.at("payload").at("reason");
+    long long retryAfterMs = j.at("payload").value("retryAfterMs", 0LL);
+    if (reason == "overload") {
+        uiManager.drawMessage("system", "Server overloaded: your message was not delivered. Try again in "
+                              + to_string(retryAfterMs) + " ms.", Color::Red);
+    } else {
+        uiManager.drawMessage("system", "Sending too fast: the server is pacing your messages.", Color::Yellow);
+    }
+}
+
+// Cada sala começa do zero: lista de membros e épocas próprias. A sala nova passa a receber o que é digitado.
+void Client::handleRoomJoined(const json& j) {
+    StreamId id = j.at("stream").get<StreamId>();
+    string roomName = j.at("payload").at("room");
+    {
+        lock_guard<mutex> lock(keyMutex);
+        streams.erase(id);
+        auto joined = streams.emplace(id, Stream(id, roomName, KEY_GRACE_PERIOD)).first;
+        joined->second.lastSeq = j.at("payload").value("lastSeq", 0ULL);
+        activeStream = id;
+    }
+    uiManager.drawMessage("system", "Joined room '" + roomName + "'.", Color::Yellow);
+    uiManager.updateStatus(statusLine());
+}
+
+void Client::handleRoomLeft(Stream& stream) {
+    string roomName = stream.room;
+    {
+        lock_guard<mutex> lock(keyMutex);
+        if (!stream.outgoingQueue.empty()) {
+            uiManager.drawMessage("system", to_string(stream.outgoingQueue.size()) + " queued message(s) discarded.", Color::Yellow);
+        }
+        bool wasActive = activeStream == stream.id;
+        streams.erase(stream.id);
+        if (wasActive) {
+            activeStream = streams.empty() ? 0 : streams.begin()->first;
+        }
+    }
+    uiManager.drawMessage("system", "Left room '" + roomName + "'.", Color::Yellow);
+    uiManager.updateStatus(statusLine());
+}
+
+void Client::handleHistoryEnd(Stream& stream, const json& j) {
+    {
+        lock_guard<mutex> lock(keyMutex);
+        if (!stream.historyPending) {
+            return;  // Fim do reenvio da retomada, não de um /history
+        }
+        stream.historyPending = false;
+    }
+    size_t count = j.at("payload").value("count", 0);
+    ull nextSeq = j.at("payload").value("nextSeq", 0ULL);
+    ull lastSeq = j.at("payload").value("lastSeq", 0ULL);
+    string summary = "End of history: " + to_string(count) + " message(s).";
+    if (count > 0 && nextSeq <= lastSeq) {
+        summary += " More after #" + to_string(nextSeq - 1) + ".";
+    }
+    uiManager.drawMessage(roomLabel(stream, "system"), summary, Color::Yellow);
+}
+
+// Entrada rápida: quem já estava avança a chave atual com o ratchet; quem entrou espera a
+// chave nova do distribuidor. Todos trocam de época com S2C_KEY_EXCHANGE_COMPLETED.
+void Client::handleFastJoin(Stream& stream, const json& j) {
+    ull epoch = j.at("payload").at("epochId");
+    ull fromEpoch = j.at("payload").at("fromEpoch");
+    string joiner = j.at("payload").at("joiner");
+    string distributor = j.at("payload").at("distributor");
+
+    CryptoUtils::GroupKey nextKey;
+    {
+        lock_guard<mutex> lock(keyMutex);
+        if (joiner == username) {
+            stream.keyRing.beginRekey(epoch);
+            uiManager.drawMessage(roomLabel(stream, "System"), "Waiting for the group key from " + distributor + "...", Color::Gray);
+            return;
+        }
+        CryptoUtils::GroupKey groupKey;
+        if (!stream.keyRing.keyFor(fromEpoch, groupKey)) {
+            uiManager.debugLog("Cannot ratchet from unknown epoch " + to_string(fromEpoch));
+            return;
+        }
+        nextKey = CryptoUtils::ratchetKey(groupKey, epoch);
+        stream.keyRing.beginRekey(epoch);
+        stream.keyRing.setPending(epoch, nextKey);
+    }
+    uiManager.drawMessage(roomLabel(stream, "System"), "Group key ratcheted to epoch " + to_string(epoch) + " for " + joiner, Color::Gray);
+
+    if (distributor == username) {
+        string joinerPublicKey;
+        CryptoUtils::GroupKey pairwise;
+        if (!groupElementFromJson(j.at("payload").at("joinerPublicKey"), joinerPublicKey) ||
+            !CryptoUtils::pairwiseSecret(keyGroup, privateKey, joinerPublicKey, pairwise)) {
+            uiManager.drawMessage("System", "Invalid public key from " + joiner + ", group key not sent", Color::Red);
+            return;
+        }
+        CryptoUtils::GroupKey wrapped = CryptoUtils::wrapKey(nextKey, pairwise, epoch);
+        json delivery;
+        delivery["type"] = "C2S_KEY_DELIVERY";
+        delivery["stream"] = stream.id;
+        delivery["payload"]["epochId"] = epoch;
+        delivery["payload"]["wrappedKey"] = CryptoUtils::base64Encode(string(wrapped.begin(), wrapped.end()));
+        delivery["payload"]["keyConfirmation"] = CryptoUtils::base64Encode(CryptoUtils::keyConfirmation(nextKey, epoch));
+        if (!sendJson(delivery)) {
+            uiManager.drawMessage("System", "Failed to send group key to " + joiner, Color::Yellow);
+        }
+    }
+}
+
+void Client::handleKeyDelivery(Stream& stream, const json& j) {
+    ull epoch = j.at("payload").at("epochId");
+    string from = j.at("payload").at("from");
+    string fromPublicKey, wrappedBytes;
+    CryptoUtils::GroupKey pairwise, wrapped;
+    if (!groupElementFromJson(j.at("payload").at("fromPublicKey"), fromPublicKey) ||
+        !CryptoUtils::pairwiseSecret(keyGroup, privateKey, fromPublicKey, pairwise) ||
+        !j.at("payload").at("wrappedKey").is_string() ||
+        !CryptoUtils::base64Decode(j.at("payload").at("wrappedKey").get<string>(), wrappedBytes) ||
+        wrappedBytes.size() != wrapped.size()) {
+        uiManager.drawMessage(roomLabel(stream, "System"), "Invalid group key delivery from " + from, Color::Red);
+        return;
+    }
+    memcpy(wrapped.data(), wrappedBytes.data(), wrapped.size());
+    CryptoUtils::GroupKey groupKey = CryptoUtils::unwrapKey(wrapped, pairwise, epoch);
+    {
+        lock_guard<mutex> lock(keyMutex);
+        stream.keyRing.setPending(epoch, groupKey);
+    }
+    uiManager.drawMessage(roomLabel(stream, "System"), "Group key for epoch " + to_string(epoch) + " received from " + from, Color::Gray);
+
+    // Mesma confirmação da troca completa: o servidor compara o compromisso com o de quem entregou
+    json received;
+    received["type"] = "C2S_ROUND2_COMPLETED";
+    received["stream"] = stream.id;
+    received["payload"]["epochId"] = epoch;
+    received["payload"]["keyConfirmation"] = CryptoUtils::base64Encode(CryptoUtils::keyConfirmation(groupKey, epoch));
+    received["payload"]["nextPublicKey"] = groupElementToJson(announceNextKey(stream));
+    if (!sendJson(received)) {
+        uiManager.drawMessage("System", "Failed to confirm group key", Color::Yellow);
+    }
+}
+
+// Chave privada do par que o servidor listou para nós nesta troca. Pares anunciados antes
+// dele nunca mais serão listados e são descartados; ele fica até ser substituído, porque
+// uma troca abortada recomeça com as mesmas chaves.
+string Client::exchangeKeyFor(Stream& stream, const string& myPublicKey) {
+    if (myPublicKey == publicKey) {
+        return privateKey;
+    }
+    for (size_t i = 0; i < stream.announcedKeys.size(); ++i) {
+        if (stream.announcedKeys[i].publicKey == myPublicKey) {
+            string key = stream.announcedKeys[i].privateKey;
+            stream.announcedKeys.erase(stream.announcedKeys.begin(), stream.announcedKeys.begin() + i);
+            return key;
+        }
+    }
+    uiManager.debugLog("Server listed an unknown public key for us: " + groupElementToJson(myPublicKey).dump());
+    return privateKey;
+}
+
+// Par da próxima troca completa nesta sala, tirado do pool (sem exponenciação aqui)
+string Client::announceNextKey(Stream& stream) {
+    const size_t MAX_ANNOUNCED_KEYS = 8;
+    KeyPool::KeyPair next = keyPool.take();
+    stream.announcedKeys.push_back(next);
+    if (stream.announcedKeys.size() > MAX_ANNOUNCED_KEYS) {
+        stream.announcedKeys.pop_front();
+    }
+    return next.publicKey;
+}
+
+string Client::statusLine() {
+    lock_guard<mutex> lock(keyMutex);
+    auto active = streams.find(activeStream);
+    return "Connected as: " + username + "  |  Room: " + (active == streams.end() ? "-" : active->second.room);
+}
+
+// Mensagens de salas que não são a ativa aparecem com o nome da sala
+string Client::roomLabel(const Stream& stream, const string& sender) const {
+    return stream.id == activeStream ? sender : "[" + stream.room + "] " + sender;
+}
+
+void Client::handleUserNotification(const Stream* stream, const json& j) {
     string eventName = j.at("payload").at("event");
+    string label = stream ? roomLabel(*stream, "system") : "system";
 
     if (eventName == "USER_JOINED") {
         string username = j.at("payload").at("username");
         string welcomeMsg = "'" + username + "' has joined!";
-        uiManager.drawMessage("system", welcomeMsg, Color::Yellow);
+        uiManager.drawMessage(label, welcomeMsg, Color::Yellow);
     }
     else if (eventName == "USER_DISCONNECTED") {
         string username = j.at("payload").at("username");
         string disconnectMsg = "'" + username + "' has left the chat.";
-        uiManager.drawMessage("system", disconnectMsg, Color::Yellow);
+        uiManager.drawMessage(label, disconnectMsg, Color::Yellow);
+    }
+    else if (eventName == "USER_LEFT") {
+        string username = j.at("payload").at("username");
+        string leftMsg = "'" + username + "' has left the room.";
+        uiManager.drawMessage(label, leftMsg, Color::Yellow);
+    }
+    else if (eventName == "USER_TIMED_OUT") {
+        string username = j.at("payload").at("username");
+        string timeoutMsg = "'" + username + "' was removed for not answering the key exchange.";
+        uiManager.drawMessage(label, timeoutMsg, Color::Yellow);
+    }
+    else if (eventName == "USER_REJECTED") {
+        string username = j.at("payload").at("username");
+        string rejectedMsg = "'" + username + "' was removed for sending an invalid key exchange value.";
+        uiManager.drawMessage(label, rejectedMsg, Color::Red);
+    }
+    else if (eventName == "KEY_EXCHANGE_FAILED") {
+        uiManager.drawMessage(label, "Members derived different group keys. Messages stay queued until the next key exchange.", Color::Red);
+    }
+    else if (eventName == "KEY_GROUP_MISMATCH") {
+        // O servidor não nos pôs na sala e já liberou o stream para um /join futuro
+        string roomName = j.at("payload").at("room");
+        string roomGroup = j.at("payload").at("keyGroup");
+        uiManager.drawMessage(label, "Room '" + roomName + "' uses the " + roomGroup + " key group, but this client uses "
+                              + CryptoUtils::keyGroupName(keyGroup) + ". Restart with --key-group " + roomGroup + " to join it.", Color::Red);
+    }
+    else if (eventName == "USERNAME_TAKEN") {
+        string username = j.at("payload").at("username");
+        string takenMsg = "Username '" + username + "' is already in use. Reconnect with another name.";
+        uiManager.drawMessage(label, takenMsg, Color::Red);
     }
     else {
         uiManager.debugLog("Error while receivingMessage\n\tEvent: " + eventName + " not defined");
@@ -335,24 +1011,164 @@ void Client::handleUserNotification(const json& j) {
 
 }
 
+// /join <sala>, /leave (sai da sala ativa), /switch <sala> e /history [n] (últimas n mensagens
+// da sala ativa); retorna false se a linha não é um comando
+bool Client::handleCommand(const string& msg)
+{
+    json j;
+    if (msg.rfind("/join ", 0) == 0) {
+        j["type"] = "C2S_JOIN_ROOM";
+        j["payload"]["room"] = msg.substr(6);
+    } else if (msg == "/leave") {
+        lock_guard<mutex> lock(keyMutex);
+        if (!streams.count(activeStream)) {
+            uiManager.drawMessage("System", "You are not in any room.", Color::Yellow);
+            return true;
+        }
+        j["type"] = "C2S_LEAVE_ROOM";
+        j["stream"] = activeStream.load();
+        j["payload"] = json::object();
+    } else if (msg == "/history" || msg.rfind("/history ", 0) == 0) {
+        ull count = msg.size() > 9 ? strtoull(msg.c_str() + 9, nullptr, 10) : HISTORY_PAGE;
+        count = max<ull>(1, min<ull>(count, HISTORY_PAGE));
+        lock_guard<mutex> lock(keyMutex);
+        auto active = streams.find(activeStream);
+        if (active == streams.end()) {
+            uiManager.drawMessage("System", "You are not in any room.", Color::Yellow);
+            return true;
+        }
+        ull lastSeq = active->second.lastSeq;
+        active->second.historyPending = true;
+        j["type"] = "C2S_FETCH_HISTORY";
+        j["stream"] = active->first;
+        j["payload"]["fromSeq"] = lastSeq >= count ? lastSeq - count + 1 : 1;
+        j["payload"]["limit"] = count;
+    } else if (msg.rfind("/switch ", 0) == 0) {
+        string roomName = msg.substr(8);
+        bool found = false;
+        {
+            lock_guard<mutex> lock(keyMutex);
+            for (const auto& entry : streams) {
+                if (entry.second.room == roomName) {
+                    activeStream = entry.first;
+                    found = true;
+                }
+            }
+        }
+        if (found) {
+            uiManager.updateStatus(statusLine());
+        } else {
+            uiManager.drawMessage("System", "You are not in room '" + roomName + "'. Use /join first.", Color::Yellow);
+        }
+        return true;
+    } else {
+        return false;
+    }
+
+    if (!sendJson(j)) {
+        uiManager.drawMessage("System", "Failed to send command", Color::Yellow);
+    }
+    return true;
+}
+
 void Client::sendMessage(const string& msg)
 {
     if (!msg.empty())
     {
-        uiManager.drawMessage("You", msg, Color::Gray);
+        if (handleCommand(msg))
+            return;
+
+        // Época e chave são copiadas com keyMutex; o envio, que pode bloquear, vai sem ele
+        // para não travar a thread de recepção (PONG, rodadas) enquanto o socket está cheio
+        StreamId streamId;
+        ull epoch;
+        CryptoUtils::GroupKey key;
+        {
+            lock_guard<mutex> lock(keyMutex);
+            auto active = streams.find(activeStream);
+            if (active == streams.end())
+            {
+                uiManager.drawMessage("System", "You are not in any room. Use /join <room>.", Color::Yellow);
+                return;
+            }
+            Stream& stream = active->second;
+            uiManager.drawMessage("You", msg, Color::Gray);
 
-        string encryptedMessage = CryptoUtils::encryptMessage(msg, sharedSecret);
+            if (stream.keyRing.isRekeying() || reconnecting)
+            {
+                // Segura a mensagem até a nova época ser confirmada (ou a sessão ser retomada)
+                stream.outgoingQueue.push_back(msg);
+                return;
+            }
+            streamId = stream.id;
+            epoch = stream.keyRing.currentEpoch();
+            key = stream.keyRing.currentKey();
+        }
+
+        if (!sendEncrypted(streamId, msg, epoch, key) && resumable)
+        {
+            // Reenviada depois da retomada, se a sala ainda existir
+            lock_guard<mutex> lock(keyMutex);
+            auto stream = streams.find(streamId);
+            if (stream != streams.end())
+            {
+                stream->second.outgoingQueue.push_back(msg);
+            }
+        }
+    }
+}
+
+// Deve ser chamada com keyMutex travado
+void Client::flushOutgoingQueue(Stream& stream)
+{
+    while (!stream.outgoingQueue.empty() && connected && !reconnecting)
+    {
+        if (!sendEncrypted(stream.id, stream.outgoingQueue.front(), stream.keyRing.currentEpoch(), stream.keyRing.currentKey()))
+            break;
+        stream.outgoingQueue.pop_front();
+    }
+}
 
-        json j;
-        j["type"] = "C2S_SEND_GROUP_MESSAGE";
-        j["payload"]["ciphertext"] = encryptedMessage;
+// O frame é montado à mão num buffer por thread (digitação e recepção enviam), com o
+// ciphertext cifrado direto no lugar; base64 não tem caracteres que precisem de escape
+bool Client::sendEncrypted(StreamId streamId, const string& msg, ull epoch, const CryptoUtils::GroupKey& key)
+{
+    char head[96];
+    char tail[48];
+    int headLength = snprintf(head, sizeof(head),
+                              "{\"type\":\"C2S_SEND_GROUP_MESSAGE\",\"stream\":%u,\"payload\":{\"ciphertext\":\"",
+                              (unsigned)streamId);
+    int tailLength = snprintf(tail, sizeof(tail), "\",\"epochId\":%llu}}", epoch);
+    size_t cipherLength = CryptoUtils::encryptedMessageLength(msg.size());
 
-        string jsonStr = j.dump();
+    thread_local string frame;
+    frame.resize(headLength + cipherLength + tailLength);
+    memcpy(&frame[0], head, headLength);
+    CryptoUtils::encryptMessage(msg.data(), msg.size(), key, &frame[headLength]);
+    memcpy(&frame[headLength + cipherLength], tail, tailLength);
 
-        if (!sendAll(clientSocket, jsonStr.c_str(), jsonStr.size()))
+    if (!sendFrame(frame))
+    {
+        if (resumable)
         {
-            uiManager.drawMessage("System", "Failed to send message", Color::Yellow);
-            connected = false;
+            // A thread de recepção reconecta; quem chamou guarda a mensagem para reenviar
+            shutdown(clientSocket, SHUT_RDWR);
+            return false;
         }
+        uiManager.drawMessage("System", "Failed to send message", Color::Yellow);
+        connected = false;
+        return false;
     }
+    return true;
+}
+
+bool Client::sendJson(const json& j)
+{
+    return sendFrame(j.dump());
+}
+
+bool Client::sendFrame(const string& frame)
+{
+    lock_guard<mutex> lock(sendMutex);
+    return sendAll(clientSocket, frame.data(), frame.size());
 }
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <condition_variable>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -11,6 +15,9 @@
 
 #include "UIManager.h"
 #include "diffiehellman.h"
+#include "keyagreement.h"
+#include "keyring.h"
+#include "keypool.h"
 #include <nlohmann/json.hpp>
 
 using namespace std;
@@ -19,28 +26,104 @@ using namespace nlohmann;
 class Client
 {
 private:
-    int clientSocket;
+    atomic<int> clientSocket;
     sockaddr_in serverAddress;
     atomic<bool> connected;
     thread receiverThread;
+    thread heartbeatThread;
     UIManager& uiManager;
     string username;
 
-    ull privateKey;
-    ull publicKey;
+    // Grupo do Burmester-Desmedt (MODP ou Curve25519), informado na autenticação
+    CryptoUtils::KeyGroup keyGroup;
+    // Par de entrada: identifica o membro e cifra a entrega da entrada rápida. As trocas
+    // completas usam pares efêmeros do pool, um por época.
+    KeyPool keyPool;
+    string privateKey;
+    string publicKey;
 
-    std::vector<CryptoUtils::GroupMember> groupMembers;
-    ull sharedSecret = 0;
+    using StreamId = uint32_t;
+
+    // Uma sala multiplexada na conexão: lista de membros, troca de chaves e chaves próprias
+    struct Stream {
+        StreamId id;
+        string room;
+        std::vector<CryptoUtils::RingMember> groupMembers;
+        unordered_map<string, size_t> memberIndex;  // Username -> posição no anel
+        ull membershipVersion = 0;          // Versão da lista de membros aplicada localmente
+        bool membershipSyncPending = false; // Já pediu ao servidor as versões que faltam
+        ull lastSeq = 0;                    // Maior sequência de chat recebida ao vivo
+        bool historyPending = false;        // /history em andamento: sequências antigas são esperadas
+        // Chaves por época e mensagens aguardando a confirmação da época nova
+        KeyRing keyRing;
+        deque<string> outgoingQueue;
+        // Pares anunciados para as próximas trocas completas, do mais antigo ao mais novo
+        deque<KeyPool::KeyPair> announcedKeys;
+        string exchangePrivateKey;  // Par desta troca, escolhido na rodada 1
+        // Anel da troca em andamento, na ordem e com as chaves que o servidor mandou na
+        // rodada 1; a lista de membros acima só serve para exibição e pode estar atrasada
+        std::vector<CryptoUtils::RingMember> exchangeRing;
+        unordered_map<string, size_t> exchangeIndex;
+
+        Stream(StreamId id, const string& room, std::chrono::milliseconds gracePeriod)
+            : id(id), room(room), keyRing(gracePeriod) {}
+    };
+
+    // Salas em que estamos, pelo stream que o servidor atribuiu. Só a thread de recepção
+    // cria ou remove streams, sempre com keyMutex; o que é digitado vai para activeStream.
+    mutex keyMutex;
+    unordered_map<StreamId, Stream> streams;
+    atomic<StreamId> activeStream{0};
+    // A thread de recepção também envia (rodadas e fila), então os envios são serializados
+    mutex sendMutex;
+
+    // Heartbeat: PING periódico, RTT médio na barra de status e detecção de servidor morto
+    mutex heartbeatMutex;
+    condition_variable heartbeatCv;
+    atomic<int> missedHeartbeats;
+    deque<double> rttSamples;  // Últimas amostras (ms) para a média móvel
+
+    // Retomada: com o token do servidor, uma queda vira reconexão dentro do prazo em vez de saída
+    string resumeToken;
+    chrono::milliseconds resumeGrace{0};
+    atomic<bool> resumable{false};
+    atomic<bool> reconnecting{false};  // Até S2C_RESUMED o que é digitado fica na fila
 
     void receiveMessages();
+    bool reconnect();
+    void handleSession(const json& j);
+    void handleResumed();
+    void handleResumeFailed(const json& j);
+    void sendHeartbeats();
+    void handlePing(const json& j);
+    void handlePong(const json& j);
     void sendMessage(const string& msg);
-    void handleMessage(const json& j);
-    void handleUserNotification(const json& j);
+    bool sendJson(const json& j);
+    bool sendFrame(const string& frame);
+    bool sendEncrypted(StreamId streamId, const string& msg, ull epoch, const CryptoUtils::GroupKey& key);
+    void flushOutgoingQueue(Stream& stream);
+    void handleMessage(Stream& stream, const json& j);
+    void handleUserNotification(const Stream* stream, const json& j);
+    void handleSlowDown(const json& j);
+    void handleRoomJoined(const json& j);
+    void handleRoomLeft(Stream& stream);
+    void handleHistoryEnd(Stream& stream, const json& j);
+    void handleFastJoin(Stream& stream, const json& j);
+    void handleKeyDelivery(Stream& stream, const json& j);
+    string exchangeKeyFor(Stream& stream, const string& myPublicKey);
+    string announceNextKey(Stream& stream);
+    bool handleCommand(const string& msg);
+    string statusLine();
+    string roomLabel(const Stream& stream, const string& sender) const;
+    void applyMembersSnapshot(Stream& stream, const json& j);
+    void applyMembershipChange(Stream& stream, const json& j, bool added);
+    void requestMembersSync(Stream& stream);
+    void reindexMembers(Stream& stream, size_t first);
     void parseMessage(const string& msg, string& outSender, string& outMsg);
 
 
 public:
-    Client(const char *serverIp, int port, UIManager& uiManager);
+    Client(const char *serverIp, int port, UIManager& uiManager, CryptoUtils::KeyGroup keyGroup);
     ~Client();
 
     bool connectToServer();
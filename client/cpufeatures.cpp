@@ -0,0 +1,20 @@
+#include "cpufeatures.h"
+
+namespace CryptoUtils {
+
+    const CpuFeatures& cpuFeatures() {
+        static const CpuFeatures features = [] {
+            CpuFeatures f;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            f.aesni = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+                      __builtin_cpu_supports("sse4.1");
+            f.avx2 = __builtin_cpu_supports("avx2");
+            f.ssse3 = __builtin_cpu_supports("ssse3");
+            f.sse2 = __builtin_cpu_supports("sse2");
+#endif
+            return f;
+        }();
+        return features;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace CryptoUtils {
+
+    // Extensões x86 usadas pelos caminhos vetorizados; lidas do cpuid uma vez
+    struct CpuFeatures {
+        bool aesni = false;   // AES-NI + PCLMULQDQ + SSE4.1
+        bool avx2 = false;
+        bool ssse3 = false;
+        bool sse2 = false;
+    };
+    const CpuFeatures& cpuFeatures();
+}
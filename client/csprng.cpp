@@ -0,0 +1,112 @@
+#include "csprng.h"
+#include "aeadbackends.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/random.h>
+
+namespace CryptoUtils {
+
+    namespace {
+        // 16 blocos por recarga; os 32 primeiros bytes viram a chave da próxima recarga
+        // e são apagados daqui, então quem ler a memória depois não reconstrói o que saiu
+        const size_t BUFFER_BYTES = 1024;
+        const size_t KEY_BYTES = 32;
+
+        // Incrementado no filho de um fork(): pai e filho não podem continuar o mesmo fluxo
+        std::atomic<unsigned> forkGeneration{0};
+
+        void seedFromKernel(uint8_t* out, size_t length) {
+            while (length > 0) {
+                ssize_t got = getrandom(out, length, 0);
+                if (got < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error(std::string("getrandom failed: ") + strerror(errno));
+                }
+                out += got;
+                length -= got;
+            }
+        }
+
+        struct ThreadRng {
+            uint8_t key[KEY_BYTES];
+            uint8_t buffer[BUFFER_BYTES];
+            size_t available = 0;
+            unsigned generation = 0;
+            bool seeded = false;
+
+            ThreadRng() {
+                static const int registered = pthread_atfork(nullptr, nullptr, [] {
+                    forkGeneration.fetch_add(1, std::memory_order_relaxed);
+                });
+                (void)registered;
+            }
+
+            ~ThreadRng() {
+                volatile uint8_t* p = key;
+                for (size_t i = 0; i < sizeof(key); ++i) p[i] = 0;
+                p = buffer;
+                for (size_t i = 0; i < sizeof(buffer); ++i) p[i] = 0;
+            }
+
+            bool stale() const {
+                return !seeded || generation != forkGeneration.load(std::memory_order_relaxed);
+            }
+
+            void refill() {
+                if (stale()) {
+                    seedFromKernel(key, sizeof(key));
+                    generation = forkGeneration.load(std::memory_order_relaxed);
+                    seeded = true;
+                }
+                // A chave muda a cada recarga, então o nonce fixo nunca se repete com ela
+                static const uint8_t nonce[12] = {0};
+                chacha20Stream(key, nonce, 0, buffer, sizeof(buffer), chachaBackend());
+                memcpy(key, buffer, KEY_BYTES);
+                memset(buffer, 0, KEY_BYTES);
+                available = BUFFER_BYTES - KEY_BYTES;
+            }
+        };
+
+        thread_local ThreadRng threadRng;
+    }
+
+    void randomBytes(void* out, size_t length) {
+        ThreadRng& rng = threadRng;
+        if (rng.stale()) {
+            rng.available = 0;
+        }
+        uint8_t* dst = static_cast<uint8_t*>(out);
+        while (length > 0) {
+            if (rng.available == 0) {
+                rng.refill();
+            }
+            size_t take = length < rng.available ? length : rng.available;
+            uint8_t* src = rng.buffer + (BUFFER_BYTES - rng.available);
+            memcpy(dst, src, take);
+            memset(src, 0, take);  // Cada byte sai uma vez só
+            rng.available -= take;
+            dst += take;
+            length -= take;
+        }
+    }
+
+    uint64_t randomUint64() {
+        uint64_t value;
+        randomBytes(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t randomBelow(uint64_t bound) {
+        // Descarta o começo do intervalo que faria alguns restos aparecerem uma vez a mais
+        uint64_t threshold = (0 - bound) % bound;
+        uint64_t value;
+        do {
+            value = randomUint64();
+        } while (value < threshold);
+        return value % bound;
+    }
+}
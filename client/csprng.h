@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CryptoUtils {
+
+    /**
+     * @brief Bytes aleatórios criptograficamente seguros. Cada thread tem seu próprio
+     * gerador ChaCha20, semeado com getrandom() e com a chave trocada a cada recarga
+     * do buffer, então não há trava nem chamada de sistema no caminho comum.
+     * @throws std::runtime_error se o kernel não fornecer a semente.
+     */
+    void randomBytes(void* out, size_t length);
+    uint64_t randomUint64();
+
+    // Uniforme em [0, bound), sem o viés do módulo
+    uint64_t randomBelow(uint64_t bound);
+}
@@ -4,7 +4,14 @@
 #include <cstdlib>
 #include <ctime>
 #include <stdexcept>
-#include <random>
+#include <cstring>
+#include <atomic>
+#include <array>
+
+#include "aead.h"
+#include "base64.h"
+#include "csprng.h"
+#include "sha256.h"
 
 
 using ull = unsigned long long;
@@ -38,6 +45,10 @@ namespace CryptoUtils {
         ull publicKey;
     };
 
+    const size_t GROUP_KEY_BYTES = 32;
+    using GroupKey = std::array<uint8_t, GROUP_KEY_BYTES>;
+    const size_t KEY_CONFIRMATION_BYTES = 16;
+
     // ========================================================================
     // 2. FUNÇÕES CRIPTOGRÁFICAS CENTRAIS (API Pública)
     // ========================================================================
@@ -79,13 +90,7 @@ namespace CryptoUtils {
      * @return Uma chave privada aleatória dentro do intervalo válido [2, P_MODULUS - 1].
      */
     ull generatePrivateKey() {
-        static std::random_device rd;
-        static std::mt19937_64 generator(rd());
-        
-        // A distribuição deve usar 'ull' para corresponder ao tipo de P_MODULUS.
-        std::uniform_int_distribution<ull> distribution(2, P_MODULUS - 1);
-        
-        return distribution(generator);
+        return 2 + randomBelow(P_MODULUS - 2);
     }
 
 
@@ -146,62 +151,152 @@ namespace CryptoUtils {
         return final_key;
     }
 
-    // Funções para codificação segura de texto com base64
-    static const std::string base64_chars =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    
-    std::string base64_encode(const std::string &in) {
-        std::string out;
-        int val = 0, valb = -6;
-        for (unsigned char c : in) {
-            val = (val << 8) + c;
-            valb += 8;
-            while (valb >= 0) {
-                out.push_back(base64_chars[(val >> valb) & 0x3F]);
-                valb -= 6;
-            }
+    // SHA-256(rótulo || chave || época), com a época em little-endian
+    static GroupKey hashToKey(const char* label, const GroupKey& key, ull epoch) {
+        Sha256 hash;
+        hash.update(label, strlen(label));
+        hash.update(key.data(), key.size());
+        uint8_t bytes[8];
+        for (int i = 0; i < 8; ++i) {
+            bytes[i] = (uint8_t)(epoch >> (8 * i));
         }
-        if (valb > -6) out.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-        while (out.size() % 4) out.push_back('=');
+        hash.update(bytes, sizeof(bytes));
+        Sha256Digest digest = hash.finish();
+        GroupKey out;
+        memcpy(out.data(), digest.data(), out.size());
         return out;
     }
-    std::string base64_decode(const std::string &in) {
-        std::vector<int> T(256, -1);
-        for (int i = 0; i < 64; i++) T[base64_chars[i]] = i;
-
-        std::string out;
-        int val = 0, valb = -8;
-        for (unsigned char c : in) {
-            if (T[c] == -1) break;
-            val = (val << 6) + T[c];
-            valb += 6;
-            if (valb >= 0) {
-                out.push_back(char((val >> valb) & 0xFF));
-                valb -= 8;
-            }
+
+    /**
+     * @brief Avança a chave do grupo para a época nova sem troca de chaves.
+     * É de mão única: quem entra recebe a chave nova e não consegue voltar para a
+     * anterior, então não lê mensagens de antes da entrada.
+     */
+    GroupKey ratchetKey(const GroupKey& groupKey, ull epoch) {
+        return hashToKey("group-ratchet", groupKey, epoch);
+    }
+
+    /**
+     * @brief Segredo Diffie-Hellman entre dois membros, a partir das chaves públicas
+     * que já circulam na lista de membros: g^(ab) mod p.
+     */
+    ull pairwiseKey(ull myPrivateKey, ull otherPublicKey) {
+        return modularExponent(otherPublicKey, myPrivateKey, P_MODULUS);
+    }
+
+    // Cifra a chave da época para um único membro; a máscara depende da época
+    GroupKey wrapKey(const GroupKey& key, const GroupKey& pairwise, ull epoch) {
+        GroupKey mask = hashToKey("key-wrap", pairwise, epoch);
+        for (size_t i = 0; i < mask.size(); ++i) {
+            mask[i] ^= key[i];
         }
-        return out;
+        return mask;
+    }
+
+    GroupKey unwrapKey(const GroupKey& wrapped, const GroupKey& pairwise, ull epoch) {
+        return wrapKey(wrapped, pairwise, epoch);
+    }
+
+    std::string keyConfirmation(const GroupKey& key, ull epoch) {
+        GroupKey digest = hashToKey("key-confirm", key, epoch);
+        return std::string((const char*)digest.data(), KEY_CONFIRMATION_BYTES);
     }
 
-    // Utiliza XOR com rotação para variar a chave a cada caractere
-    std::string encryptMessage(std::string msg, ull key) {
-        std::string result = msg;
-        for (size_t i = 0; i < result.size(); i++) {
-            unsigned char k = static_cast<unsigned char>((key >> (i % 8)) & 0xFF);
-            result[i] ^= k;
+    namespace {
+        const size_t AEAD_HEADER_BYTES = 1 + AEAD_NONCE_BYTES;
+
+        // Chave AEAD derivada da chave do grupo; recalculada só quando a época muda
+        const AeadKey& messageKey(const GroupKey& groupKey) {
+            thread_local AeadKey cached;
+            thread_local GroupKey cachedGroupKey{};
+            thread_local bool valid = false;
+            if (!valid || cachedGroupKey != groupKey) {
+                uint8_t bytes[AEAD_KEY_BYTES];
+                hkdfSha256("group-chat-aead-v1", groupKey.data(), groupKey.size(), "message key", bytes, sizeof(bytes));
+                aeadInit(cached, bytes);
+                cachedGroupKey = groupKey;
+                valid = true;
+            }
+            return cached;
+        }
+
+        // Prefixo aleatório por processo + contador: o nonce nunca se repete para a mesma
+        // chave dentro do processo, e dois processos só colidem se sortearem o mesmo prefixo
+        void nextNonce(uint8_t nonce[AEAD_NONCE_BYTES]) {
+            static const uint64_t prefix = randomUint64();
+            static std::atomic<uint32_t> counter{0};
+            uint32_t n = counter.fetch_add(1, std::memory_order_relaxed);
+            for (int i = 0; i < 8; ++i) {
+                nonce[i] = (uint8_t)(prefix >> (8 * i));
+            }
+            for (int i = 0; i < 4; ++i) {
+                nonce[8 + i] = (uint8_t)(n >> (8 * i));
+            }
         }
-        return base64_encode(result); // transformação em texto seguro
     }
-    // XOR é simétrico -> mesmo algoritmo para criptografar e descriptografar
-    std::string decryptMessage(std::string msg, ull key) {
-        std::string raw = base64_decode(msg);  // volta para bytes originais
-        for (size_t i = 0; i < raw.size(); i++) {
-            unsigned char k = static_cast<unsigned char>((key >> (i % 8)) & 0xFF);
-            raw[i] ^= k;
+
+    size_t encryptedMessageLength(size_t length) {
+        return base64EncodedLength(AEAD_HEADER_BYTES + length + AEAD_TAG_BYTES);
+    }
+
+    size_t decryptedMessageMaxLength(size_t length) {
+        return base64DecodedMaxLength(length);
+    }
+
+    /**
+     * @brief Cifra com AEAD a chave do grupo. Formato (antes do base64):
+     * algoritmo (1 byte) || nonce (12) || ciphertext || tag (16). O byte do algoritmo
+     * também é o AAD, então trocá-lo invalida a tag.
+     *
+     * Os bytes cifrados são montados no fim de 'out' e codificados em base64 no próprio
+     * buffer, da esquerda para a direita.
+     */
+    size_t encryptMessage(const char* msg, size_t length, const GroupKey& key, char* out) {
+        size_t rawLength = AEAD_HEADER_BYTES + length + AEAD_TAG_BYTES;
+        size_t encodedLength = base64EncodedLength(rawLength);
+        uint8_t* raw = (uint8_t*)out + (encodedLength - rawLength);
+
+        AeadAlgorithm algorithm = preferredAead();
+        raw[0] = (uint8_t)algorithm;
+        nextNonce(raw + 1);
+        aeadSeal(algorithm, messageKey(key), raw + 1, raw, 1,
+                 (const uint8_t*)msg, length, raw + AEAD_HEADER_BYTES);
+        return base64Encode(raw, rawLength, out);
+    }
+
+    // Decodifica no próprio 'out', decifra no lugar e move o texto para o início
+    bool decryptMessage(const char* ciphertext, size_t length, const GroupKey& key, char* out, size_t& outLength) {
+        outLength = 0;
+        uint8_t* raw = (uint8_t*)out;
+        size_t rawLength;
+        if (!base64Decode(ciphertext, length, raw, rawLength) || rawLength < AEAD_HEADER_BYTES + AEAD_TAG_BYTES) {
+            return false;
+        }
+        uint8_t header[AEAD_HEADER_BYTES];
+        memcpy(header, raw, sizeof(header));
+        uint8_t* body = raw + AEAD_HEADER_BYTES;
+        size_t bodyLength = rawLength - AEAD_HEADER_BYTES;
+        if (!aeadOpen((AeadAlgorithm)header[0], messageKey(key), header + 1, header, 1, body, bodyLength, body)) {
+            return false;
         }
-        return raw;
+        outLength = bodyLength - AEAD_TAG_BYTES;
+        memmove(out, body, outLength);
+        return true;
+    }
+
+    std::string encryptMessage(const std::string& msg, const GroupKey& key) {
+        std::string out(encryptedMessageLength(msg.size()), '\0');
+        encryptMessage(msg.data(), msg.size(), key, &out[0]);
+        return out;
+    }
+
+    // Retorna false se a mensagem foi alterada, está truncada ou veio de outra chave
+    bool decryptMessage(const std::string& msg, const GroupKey& key, std::string& out) {
+        out.resize(decryptedMessageMaxLength(msg.size()));
+        size_t length;
+        bool ok = decryptMessage(msg.data(), msg.size(), key, &out[0], length);
+        out.resize(length);
+        return ok;
     }
 
 } // namespace CryptoUtils
@@ -302,7 +397,8 @@ public:
     std::cout << "Original Message: " << message << std::endl;
     std::string encryptedMessage = CryptoUtils::encryptMessage(message, firstSecret);
     std::cout << "Encrypted Message: " << encryptedMessage << std::endl;
-    std::string decryptedMessage = CryptoUtils::decryptMessage(encryptedMessage, firstSecret);
+    std::string decryptedMessage;
+    CryptoUtils::decryptMessage(encryptedMessage, firstSecret, decryptedMessage);
     std::cout << "Decrypted Message: " << decryptedMessage << std::endl;
 
     return 0;
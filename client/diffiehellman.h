@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -11,6 +13,10 @@ namespace CryptoUtils {
     const ull P_MODULUS = 3786491543;
     const int G_GENERATOR = 5;
 
+    // Chave do grupo de uma época: hash do segredo do Burmester-Desmedt, qualquer que seja o grupo
+    const size_t GROUP_KEY_BYTES = 32;
+    using GroupKey = std::array<uint8_t, GROUP_KEY_BYTES>;
+
     struct GroupMember {
         std::string id;
         ull publicKey;
@@ -23,6 +29,25 @@ namespace CryptoUtils {
     ull calculateIntermediateValue(ull myPrivateKey, const GroupMember& before, const GroupMember& after);
     ull calculateSharedSecret(ull myPrivateKey, int myIndex, const std::vector<GroupMember>& orderedMembers, const std::vector<ull>& intermediateValues);
 
-    std::string encryptMessage(std::string msg, ull publicKey);
-    std::string decryptMessage(std::string msg, ull privateKey);
+    // Entrada rápida: ratchet da chave do grupo e entrega da chave nova a quem entrou
+    GroupKey ratchetKey(const GroupKey& groupKey, ull epoch);
+    ull pairwiseKey(ull myPrivateKey, ull otherPublicKey);
+    GroupKey wrapKey(const GroupKey& key, const GroupKey& pairwise, ull epoch);
+    GroupKey unwrapKey(const GroupKey& wrapped, const GroupKey& pairwise, ull epoch);
+
+    // Compromisso com a chave da época (16 bytes): o servidor compara os dos membros sem conhecê-la
+    const size_t KEY_CONFIRMATION_BYTES = 16;
+    std::string keyConfirmation(const GroupKey& key, ull epoch);
+
+    // Mensagens do chat: AEAD (AES-256-GCM ou ChaCha20-Poly1305) com chave derivada
+    // da chave do grupo; decryptMessage retorna false se a autenticação falhar
+    std::string encryptMessage(const std::string& msg, const GroupKey& key);
+    bool decryptMessage(const std::string& msg, const GroupKey& key, std::string& out);
+
+    // Mesmas operações sobre buffers do chamador, sem alocação. 'out' tem
+    // encryptedMessageLength(length) / decryptedMessageMaxLength(length) bytes.
+    size_t encryptedMessageLength(size_t length);
+    size_t decryptedMessageMaxLength(size_t length);
+    size_t encryptMessage(const char* msg, size_t length, const GroupKey& key, char* out);
+    bool decryptMessage(const char* ciphertext, size_t length, const GroupKey& key, char* out, size_t& outLength);
 }
\ No newline at end of file
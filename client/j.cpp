@@ -8,7 +8,7 @@ using json = nlohmann::json;
 
 void handle_key_exchange(const json& j) {
     cout << "[INITIATE_KEY_EXCHANGE]\n";
-    cout << "Epoch ID: "    << j["payload"]["epoch_id"] << "\n";
+    cout << "Epoch ID: "    << j["payload"]["epochId"] << "\n";
     cout << "Group Size: "  << j["payload"]["groupSize"] << "\n";
 
     cout << "Ordered members:\n";
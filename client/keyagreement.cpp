@@ -0,0 +1,216 @@
+#include "keyagreement.h"
+#include "bdcheck.h"
+#include "csprng.h"
+#include "ed25519.h"
+#include "sha256.h"
+
+#include <cstring>
+
+namespace CryptoUtils {
+
+    namespace {
+        // SHA-256(rótulo || segredo): a chave não carrega a estrutura do grupo
+        GroupKey hashSecret(const char* label, const uint8_t* secret, size_t length) {
+            Sha256 hash;
+            hash.update(label, strlen(label));
+            hash.update(secret, length);
+            Sha256Digest digest = hash.finish();
+            GroupKey key;
+            memcpy(key.data(), digest.data(), key.size());
+            return key;
+        }
+
+        GroupKey hashModp(const char* label, ull value) {
+            std::string bytes = modpElement(value);
+            return hashSecret(label, (const uint8_t*)bytes.data(), bytes.size());
+        }
+
+        GroupKey hashPoint(const char* label, const Ed25519::Point& point) {
+            uint8_t bytes[Ed25519::POINT_BYTES];
+            Ed25519::encode(bytes, point);
+            return hashSecret(label, bytes, sizeof(bytes));
+        }
+
+        // Qualquer ponto da curva, inclusive a identidade (X de um anel com dois membros)
+        bool decodePoint(const std::string& element, Ed25519::Point& out) {
+            return element.size() == Ed25519::POINT_BYTES && Ed25519::decode((const uint8_t*)element.data(), out);
+        }
+
+        // Chave pública: além de estar na curva, não pode ter ordem pequena
+        bool decodePublicKey(const std::string& element, Ed25519::Point& out) {
+            return decodePoint(element, out) && !Ed25519::hasSmallOrder(out);
+        }
+
+        bool validScalar(const std::string& privateKey) {
+            return privateKey.size() == Ed25519::SCALAR_BYTES;
+        }
+
+        const uint8_t* scalar(const std::string& privateKey) {
+            return (const uint8_t*)privateKey.data();
+        }
+    }
+
+    const char* keyGroupName(KeyGroup group) {
+        return group == KeyGroup::Ed25519 ? "ed25519" : "modp";
+    }
+
+    bool parseKeyGroup(const std::string& name, KeyGroup& out) {
+        if (name == "modp") {
+            out = KeyGroup::Modp;
+        } else if (name == "ed25519") {
+            out = KeyGroup::Ed25519;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    std::string modpElement(ull value) {
+        std::string bytes(8, '\0');
+        for (int i = 0; i < 8; ++i) {
+            bytes[i] = (char)(value >> (8 * i));
+        }
+        return bytes;
+    }
+
+    bool modpValue(const std::string& element, ull& out) {
+        if (element.size() != 8) {
+            return false;
+        }
+        out = 0;
+        for (int i = 0; i < 8; ++i) {
+            out |= (ull)(uint8_t)element[i] << (8 * i);
+        }
+        return out != 0 && out < P_MODULUS;
+    }
+
+    KeyPair generateKeyPair(KeyGroup group) {
+        if (group == KeyGroup::Modp) {
+            ull privateKey = generatePrivateKey();
+            return {modpElement(privateKey), modpElement(generatePublicKey(privateKey))};
+        }
+        // Escalar "clampado" como no X25519: múltiplo de 8, com o bit 254 ligado
+        uint8_t k[Ed25519::SCALAR_BYTES];
+        randomBytes(k, sizeof(k));
+        k[0] &= 248;
+        k[31] &= 127;
+        k[31] |= 64;
+        uint8_t publicKey[Ed25519::POINT_BYTES];
+        Ed25519::encode(publicKey, Ed25519::scalarMult(k, Ed25519::basePoint()));
+        KeyPair pair{std::string((const char*)k, sizeof(k)), std::string((const char*)publicKey, sizeof(publicKey))};
+        memset(k, 0, sizeof(k));
+        return pair;
+    }
+
+    // X_i = z_{i+1} / z_{i-1} elevado a r_i, ou [r_i](z_{i+1} - z_{i-1}) na curva
+    bool intermediateValue(KeyGroup group, const std::string& privateKey, const RingMember& self,
+                           const RingMember& before, const RingMember& after, ull epoch,
+                           std::string& out, IntermediateProof& proof) {
+        if (group == KeyGroup::Modp) {
+            using Group = BdCheck::ModpGroup;
+            ull r, z, zBefore, zAfter;
+            if (!modpValue(privateKey, r) || !modpValue(self.publicKey, z) ||
+                !modpValue(before.publicKey, zBefore) || !modpValue(after.publicKey, zAfter)) {
+                return false;
+            }
+            Group::Element h = Group::ratio(zAfter, zBefore);
+            Group::Element x = calculateIntermediateValue(r, {before.id, zBefore}, {after.id, zAfter});
+            Group::Proof p = Group::prove(r, randomBelow(Group::P - 1), z, h, x, epoch);
+            out = modpElement(x);
+            proof = {modpElement(p.c), modpElement(p.s)};
+            return true;
+        }
+
+        using Group = BdCheck::EdGroup;
+        Ed25519::Point z, zBefore, zAfter;
+        if (!validScalar(privateKey) || !decodePublicKey(self.publicKey, z) ||
+            !decodePublicKey(before.publicKey, zBefore) || !decodePublicKey(after.publicKey, zAfter)) {
+            return false;
+        }
+        Group::Element h = Group::ratio(zAfter, zBefore);
+        Group::Element x = Ed25519::scalarMult(scalar(privateKey), h);
+
+        // A prova trabalha com escalares módulo l; o nonce sai de 64 bytes para não ter viés
+        uint8_t r[Ed25519::SCALAR_BYTES], k[Ed25519::SCALAR_BYTES], wide[2 * Ed25519::SCALAR_BYTES];
+        Ed25519::scalarReduce(scalar(privateKey), Ed25519::SCALAR_BYTES, r);
+        randomBytes(wide, sizeof(wide));
+        Ed25519::scalarReduce(wide, sizeof(wide), k);
+        Group::Proof p = Group::prove(r, k, z, h, x, epoch);
+        memset(r, 0, sizeof(r));
+        memset(k, 0, sizeof(k));
+        memset(wide, 0, sizeof(wide));
+
+        uint8_t bytes[Ed25519::POINT_BYTES];
+        Ed25519::encode(bytes, x);
+        out.assign((const char*)bytes, sizeof(bytes));
+        proof = {std::string((const char*)p.c, sizeof(p.c)), std::string((const char*)p.s, sizeof(p.s))};
+        return true;
+    }
+
+    /**
+     * @brief K = [N·r_i]z_{i-1} + soma de (N-1-j)·X_{i+j}, para j de 0 a N-2.
+     * Na curva os coeficientes saem de somas acumuladas: a soma dos prefixos
+     * X_i, X_i + X_{i+1}, ... conta cada X_{i+j} exatamente N-1-j vezes.
+     */
+    bool sharedSecret(KeyGroup group, const std::string& privateKey, size_t myIndex,
+                      const std::vector<RingMember>& members, const std::vector<std::string>& intermediateValues,
+                      GroupKey& out) {
+        const size_t N = members.size();
+        if (N == 0 || intermediateValues.size() != N || myIndex >= N) {
+            return false;
+        }
+        const RingMember& before = members[(myIndex + N - 1) % N];
+
+        if (group == KeyGroup::Modp) {
+            ull r;
+            std::vector<GroupMember> ring(N);
+            std::vector<ull> values(N);
+            if (!modpValue(privateKey, r)) {
+                return false;
+            }
+            for (size_t i = 0; i < N; ++i) {
+                ring[i].id = members[i].id;
+                if (!modpValue(members[i].publicKey, ring[i].publicKey) || !modpValue(intermediateValues[i], values[i])) {
+                    return false;
+                }
+            }
+            out = hashModp("bd-modp", calculateSharedSecret(r, (int)myIndex, ring, values));
+            return true;
+        }
+
+        Ed25519::Point zBefore;
+        if (!validScalar(privateKey) || !decodePublicKey(before.publicKey, zBefore)) {
+            return false;
+        }
+        Ed25519::Point key = Ed25519::smallMult(N, Ed25519::scalarMult(scalar(privateKey), zBefore));
+        Ed25519::Point prefix = Ed25519::identity();
+        for (size_t j = 0; j + 1 < N; ++j) {
+            Ed25519::Point x;
+            if (!decodePoint(intermediateValues[(myIndex + j) % N], x)) {
+                return false;
+            }
+            prefix = Ed25519::add(prefix, x);
+            key = Ed25519::add(key, prefix);
+        }
+        out = hashPoint("bd-ed25519", key);
+        return true;
+    }
+
+    bool pairwiseSecret(KeyGroup group, const std::string& privateKey, const std::string& otherPublicKey,
+                        GroupKey& out) {
+        if (group == KeyGroup::Modp) {
+            ull r, other;
+            if (!modpValue(privateKey, r) || !modpValue(otherPublicKey, other)) {
+                return false;
+            }
+            out = hashModp("pairwise-modp", pairwiseKey(r, other));
+            return true;
+        }
+        Ed25519::Point other;
+        if (!validScalar(privateKey) || !decodePublicKey(otherPublicKey, other)) {
+            return false;
+        }
+        out = hashPoint("pairwise-ed25519", Ed25519::scalarMult(scalar(privateKey), other));
+        return true;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "diffiehellman.h"
+
+/**
+ * @brief Burmester-Desmedt em qualquer um dos grupos suportados, escolhido na entrada.
+ *
+ * As duas rodadas são as mesmas; muda só a aritmética. Chaves e elementos do grupo
+ * circulam como bytes: 8 em little-endian no MODP, 32 (ponto codificado como na RFC 8032)
+ * no Curve25519. O segredo final passa por SHA-256 e vira a GroupKey da época.
+ */
+namespace CryptoUtils {
+
+    enum class KeyGroup {
+        Modp,
+        Ed25519
+    };
+
+    // "modp" / "ed25519", como vão no C2S_AUTHENTICATE_AND_JOIN
+    const char* keyGroupName(KeyGroup group);
+    bool parseKeyGroup(const std::string& name, KeyGroup& out);
+
+    struct KeyPair {
+        std::string privateKey;
+        std::string publicKey;
+    };
+
+    // Membro no anel com a chave pública da época
+    struct RingMember {
+        std::string id;
+        std::string publicKey;
+    };
+
+    // Prova de Chaum-Pedersen que acompanha X_i: desafio e resposta, como escalares em bytes
+    // (8 em little-endian no MODP, 32 no Curve25519)
+    struct IntermediateProof {
+        std::string c;
+        std::string s;
+    };
+
+    // Elemento do MODP como bytes e de volta; false se o tamanho ou o valor não servem
+    std::string modpElement(ull value);
+    bool modpValue(const std::string& element, ull& out);
+
+    KeyPair generateKeyPair(KeyGroup group);
+
+    // As funções abaixo retornam false se alguma chave ou valor recebido não é um elemento
+    // válido do grupo (ex.: ponto fora da curva ou de ordem pequena)
+    // X_i e a prova de que ele usa a mesma chave privada da chave pública 'self' na época
+    bool intermediateValue(KeyGroup group, const std::string& privateKey, const RingMember& self,
+                           const RingMember& before, const RingMember& after, ull epoch,
+                           std::string& out, IntermediateProof& proof);
+    bool sharedSecret(KeyGroup group, const std::string& privateKey, size_t myIndex,
+                      const std::vector<RingMember>& members, const std::vector<std::string>& intermediateValues,
+                      GroupKey& out);
+    // Segredo DH entre dois membros, usado para entregar a chave na entrada rápida
+    bool pairwiseSecret(KeyGroup group, const std::string& privateKey, const std::string& otherPublicKey,
+                        GroupKey& out);
+}
@@ -0,0 +1,47 @@
+#include "keypool.h"
+
+KeyPool::KeyPool(size_t capacity, CryptoUtils::KeyGroup group) : capacity(capacity), group(group)
+{
+    worker = std::thread(&KeyPool::refillLoop, this);
+}
+
+KeyPool::~KeyPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    refillCv.notify_one();
+    worker.join();
+}
+
+KeyPool::KeyPair KeyPool::take()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!ready.empty()) {
+            KeyPair pair = std::move(ready.front());
+            ready.pop_front();
+            refillCv.notify_one();
+            return pair;
+        }
+    }
+    refillCv.notify_one();
+    return CryptoUtils::generateKeyPair(group);
+}
+
+void KeyPool::refillLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        refillCv.wait(lock, [this] { return stopping || ready.size() < capacity; });
+        if (stopping) {
+            return;
+        }
+        // Gera fora da trava: take() não espera pela exponenciação
+        lock.unlock();
+        KeyPair pair = CryptoUtils::generateKeyPair(group);
+        lock.lock();
+        ready.push_back(std::move(pair));
+    }
+}
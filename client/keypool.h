@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "keyagreement.h"
+
+/**
+ * @brief Pares de chaves efêmeros gerados antes de serem pedidos.
+ *
+ * Cada troca de chaves completa usa um par novo, anunciado na rodada anterior. Uma
+ * thread de fundo mantém 'capacity' pares prontos e repõe cada um que sai, então quem
+ * pede nunca paga a exponenciação (ou a multiplicação escalar) no caminho da troca de chaves.
+ */
+class KeyPool {
+public:
+    using KeyPair = CryptoUtils::KeyPair;
+
+    KeyPool(size_t capacity, CryptoUtils::KeyGroup group);
+    ~KeyPool();
+
+    // Não espera: com o pool vazio (só se a thread não deu conta) gera o par na hora
+    KeyPair take();
+
+private:
+    size_t capacity;
+    CryptoUtils::KeyGroup group;
+    std::mutex mtx;
+    std::condition_variable refillCv;
+    std::deque<KeyPair> ready;
+    bool stopping = false;
+    std::thread worker;
+
+    void refillLoop();
+};
@@ -0,0 +1,59 @@
+#include "keyring.h"
+
+KeyRing::KeyRing(std::chrono::milliseconds gracePeriod) : gracePeriod(gracePeriod)
+{
+    // Época 0: chave inicial (só zeros) usada antes da primeira troca de chaves
+    current.valid = true;
+}
+
+void KeyRing::beginRekey(ull epoch)
+{
+    rekeying = true;
+    pending = {epoch, {}, false};
+}
+
+void KeyRing::setPending(ull epoch, const GroupKey& key)
+{
+    pending = {epoch, key, true};
+}
+
+bool KeyRing::confirm(ull epoch)
+{
+    if (!pending.valid || pending.epoch != epoch) {
+        return false;
+    }
+    rotate(pending);
+    return true;
+}
+
+void KeyRing::install(ull epoch, const GroupKey& key)
+{
+    rotate({epoch, key, true});
+}
+
+bool KeyRing::keyFor(ull epoch, GroupKey& outKey) const
+{
+    if (current.valid && current.epoch == epoch) {
+        outKey = current.key;
+        return true;
+    }
+    // Outro membro pode ter recebido a confirmação antes de nós
+    if (pending.valid && pending.epoch == epoch) {
+        outKey = pending.key;
+        return true;
+    }
+    if (previous.valid && previous.epoch == epoch && Clock::now() < previousExpiry) {
+        outKey = previous.key;
+        return true;
+    }
+    return false;
+}
+
+void KeyRing::rotate(const EpochKey& next)
+{
+    previous = current;
+    previousExpiry = Clock::now() + gracePeriod;
+    current = next;
+    pending = {};
+    rekeying = false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+
+#include "diffiehellman.h"
+
+using CryptoUtils::GroupKey;
+
+/**
+ * @brief Guarda as chaves do grupo identificadas por época (epoch).
+ *
+ * Cada troca de chaves gera uma nova época. A chave em uso só é trocada quando o
+ * servidor confirma a época nova; a anterior continua válida por um período de
+ * graça para decifrar mensagens que ainda estavam em trânsito.
+ */
+class KeyRing {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit KeyRing(std::chrono::milliseconds gracePeriod);
+
+    // Rodada 1 recebida: a partir daqui as mensagens de saída devem esperar
+    void beginRekey(ull epoch);
+    // Rodada 2 concluída localmente: chave calculada mas ainda não confirmada
+    void setPending(ull epoch, const GroupKey& key);
+    // Promove a chave pendente. Retorna false se a época não corresponde.
+    bool confirm(ull epoch);
+    // Instala diretamente uma chave (ex.: usuário ficou sozinho no grupo)
+    void install(ull epoch, const GroupKey& key);
+
+    // Procura a chave de uma época (atual, pendente ou anterior dentro da graça)
+    bool keyFor(ull epoch, GroupKey& outKey) const;
+
+    bool isRekeying() const { return rekeying; }
+    ull currentEpoch() const { return current.epoch; }
+    const GroupKey& currentKey() const { return current.key; }
+
+private:
+    struct EpochKey {
+        ull epoch = 0;
+        GroupKey key{};
+        bool valid = false;
+    };
+
+    std::chrono::milliseconds gracePeriod;
+    EpochKey current;
+    EpochKey pending;
+    EpochKey previous;
+    Clock::time_point previousExpiry;
+    bool rekeying = false;
+
+    void rotate(const EpochKey& next);
+};
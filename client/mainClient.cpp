@@ -1,10 +1,29 @@
 #include "UIManager.h"
+#include "aead.h"
 #include "client.h"
 
-int main() {
+#include <cstring>
+
+int main(int argc, char* argv[]) {
+    // Curve25519 por padrão; --key-group modp para entrar em salas de clientes antigos
+    CryptoUtils::KeyGroup keyGroup = CryptoUtils::KeyGroup::Ed25519;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--self-test") == 0) {
+            return CryptoUtils::aeadSelfTest(stdout) ? 0 : 1;
+        } else if (strcmp(argv[i], "--key-group") == 0 && i + 1 < argc) {
+            if (!CryptoUtils::parseKeyGroup(argv[++i], keyGroup)) {
+                fprintf(stderr, "Unknown key group '%s' (expected ed25519 or modp)\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--key-group ed25519|modp] [--self-test]\n", argv[0]);
+            return 1;
+        }
+    }
+
     try {
         UIManager ui;
-        Client client("127.0.0.1", 8080, ui);
+        Client client("127.0.0.1", 8080, ui, keyGroup);
 
         if (client.connectToServer()) {
             client.run();
@@ -15,7 +34,6 @@ int main() {
         fprintf(stderr, "Fatal Error: %s\n", e.what());
         return 1;
     }
-    
+
     return 0;
 }
-
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ed25519.h"
+#include "sha256.h"
+
+/**
+ * @brief Conferência da rodada 1 do Burmester-Desmedt.
+ *
+ * Com valores honestos o produto dos X_i (a soma, na curva) é a identidade: os termos
+ * r_i·r_{i+1} se cancelam em volta do anel. O servidor confere isso em O(N) antes da
+ * rodada 2. Para saber quem errou quando o anel não fecha, cada cliente manda junto com
+ * X_i uma prova de Chaum-Pedersen de que usou a mesma chave privada da sua chave pública
+ * (log_g z_i = log_h X_i, com h = z_{i+1} / z_{i-1}); as provas só são conferidas nesse caso.
+ *
+ * Os dois grupos têm a mesma interface, usada pelo template checkRound1.
+ */
+namespace BdCheck {
+
+    namespace detail {
+        inline void putLe64(CryptoUtils::Sha256& hash, uint64_t value) {
+            uint8_t bytes[8];
+            for (int i = 0; i < 8; ++i) bytes[i] = (uint8_t)(value >> (8 * i));
+            hash.update(bytes, sizeof(bytes));
+        }
+    }
+
+    // Inteiros módulo p (32 bits), gerador 5; o mesmo grupo do CryptoUtils do cliente
+    struct ModpGroup {
+        using Element = uint64_t;
+        struct Proof {
+            uint64_t c;
+            uint64_t s;
+        };
+
+        static const uint64_t P = 3786491543ULL;
+        static const uint64_t G = 5;
+
+        static uint64_t mul(uint64_t a, uint64_t b) { return (uint64_t)((unsigned __int128)a * b % P); }
+
+        static uint64_t pow(uint64_t base, uint64_t exponent) {
+            uint64_t result = 1;
+            base %= P;
+            while (exponent > 0) {
+                if (exponent & 1) result = mul(result, base);
+                base = mul(base, base);
+                exponent >>= 1;
+            }
+            return result;
+        }
+
+        static bool valid(Element e) { return e != 0 && e < P; }
+        static bool validKey(Element e) { return valid(e); }
+        static Element identity() { return 1; }
+        static bool isIdentity(Element e) { return e == 1; }
+        static Element combine(Element a, Element b) { return mul(a, b); }
+        static Element ratio(Element after, Element before) { return mul(after, pow(before, P - 2)); }
+
+        // Expoentes valem módulo p - 1 (Fermat), qualquer que seja a ordem de G
+        static uint64_t challenge(uint64_t epoch, Element z, Element h, Element x, Element t1, Element t2) {
+            CryptoUtils::Sha256 hash;
+            hash.update("bd-proof-modp", 13);
+            detail::putLe64(hash, epoch);
+            for (Element e : {z, h, x, t1, t2}) detail::putLe64(hash, e);
+            CryptoUtils::Sha256Digest digest = hash.finish();
+            uint64_t c = 0;
+            for (int i = 0; i < 8; ++i) c |= (uint64_t)digest[i] << (8 * i);
+            return c % (P - 1);
+        }
+
+        // k: aleatório em [0, p - 1), nunca reusado
+        static Proof prove(uint64_t r, uint64_t k, Element z, Element h, Element x, uint64_t epoch) {
+            uint64_t c = challenge(epoch, z, h, x, pow(G, k), pow(h, k));
+            uint64_t cr = (uint64_t)((unsigned __int128)c * r % (P - 1));
+            return {c, (k + (P - 1) - cr) % (P - 1)};
+        }
+
+        static bool verify(Element z, Element h, Element x, const Proof& proof, uint64_t epoch) {
+            if (proof.c >= P - 1 || proof.s >= P - 1) {
+                return false;
+            }
+            Element t1 = mul(pow(G, proof.s), pow(z, proof.c));
+            Element t2 = mul(pow(h, proof.s), pow(x, proof.c));
+            return challenge(epoch, z, h, x, t1, t2) == proof.c;
+        }
+    };
+
+    // Curva de Edwards do Curve25519; escalares módulo l
+    struct EdGroup {
+        using Element = Ed25519::Point;
+        struct Proof {
+            uint8_t c[Ed25519::SCALAR_BYTES];
+            uint8_t s[Ed25519::SCALAR_BYTES];
+        };
+
+        // Chave pública: no subgrupo de B e fora da torção (só para o caminho de falha)
+        static bool validKey(const Element& e) { return !Ed25519::hasSmallOrder(e) && Ed25519::inPrimeOrderSubgroup(e); }
+        static Element identity() { return Ed25519::identity(); }
+        static bool isIdentity(const Element& e) { return Ed25519::isIdentity(e); }
+        static Element combine(const Element& a, const Element& b) { return Ed25519::add(a, b); }
+        static Element ratio(const Element& after, const Element& before) { return Ed25519::add(after, Ed25519::negate(before)); }
+
+        static void challenge(uint64_t epoch, const Element& z, const Element& h, const Element& x,
+                              const Element& t1, const Element& t2, uint8_t c[Ed25519::SCALAR_BYTES]) {
+            CryptoUtils::Sha256 hash;
+            hash.update("bd-proof-ed25519", 16);
+            detail::putLe64(hash, epoch);
+            for (const Element* e : {&z, &h, &x, &t1, &t2}) {
+                uint8_t bytes[Ed25519::POINT_BYTES];
+                Ed25519::encode(bytes, *e);
+                hash.update(bytes, sizeof(bytes));
+            }
+            CryptoUtils::Sha256Digest digest = hash.finish();
+            Ed25519::scalarReduce(digest.data(), digest.size(), c);
+        }
+
+        // r: escalar da chave privada; k: nonce já reduzido módulo l, nunca reusado
+        static Proof prove(const uint8_t r[Ed25519::SCALAR_BYTES], const uint8_t k[Ed25519::SCALAR_BYTES],
+                           const Element& z, const Element& h, const Element& x, uint64_t epoch) {
+            Proof proof;
+            challenge(epoch, z, h, x, Ed25519::scalarMult(k, Ed25519::basePoint()), Ed25519::scalarMult(k, h), proof.c);
+            Ed25519::scalarMulSub(proof.s, k, proof.c, r);
+            return proof;
+        }
+
+        static bool verify(const Element& z, const Element& h, const Element& x, const Proof& proof, uint64_t epoch) {
+            if (!Ed25519::scalarIsCanonical(proof.c) || !Ed25519::scalarIsCanonical(proof.s)) {
+                return false;
+            }
+            Element t1 = Ed25519::doubleScalarMultVartime(proof.s, Ed25519::basePoint(), proof.c, z);
+            Element t2 = Ed25519::doubleScalarMultVartime(proof.s, h, proof.c, x);
+            uint8_t c[Ed25519::SCALAR_BYTES];
+            challenge(epoch, z, h, x, t1, t2, c);
+            return memcmp(c, proof.c, sizeof(c)) == 0;
+        }
+    };
+
+    /**
+     * @brief Confere a rodada 1 inteira, na ordem do anel. Retorna true se o anel fecha.
+     * Se não fecha, 'offenders' recebe as posições cuja chave pública ou prova não confere
+     * (pode ficar vazio se o erro não é de ninguém em particular, ex.: listas divergentes).
+     */
+    template <class Group>
+    bool checkRound1(const std::vector<typename Group::Element>& keys, const std::vector<typename Group::Element>& values,
+                     const std::vector<typename Group::Proof>& proofs, uint64_t epoch, std::vector<size_t>& offenders) {
+        const size_t n = keys.size();
+        typename Group::Element product = Group::identity();
+        for (const auto& x : values) {
+            product = Group::combine(product, x);
+        }
+        if (Group::isIdentity(product)) {
+            return true;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const auto& before = keys[(i + n - 1) % n];
+            const auto& after = keys[(i + 1) % n];
+            if (!Group::validKey(keys[i]) ||
+                !Group::verify(keys[i], Group::ratio(after, before), values[i], proofs[i], epoch)) {
+                offenders.push_back(i);
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief Grupo de Edwards do Curve25519 (o mesmo do Ed25519): -x² + y² = 1 + d·x²·y²
+ * sobre GF(2^255 - 19).
+ *
+ * Só o que o Burmester-Desmedt precisa: soma e negação de pontos, multiplicação por
+ * escalar secreto em tempo constante e a codificação de 32 bytes da RFC 8032. Fica em
+ * include/ porque o cliente faz as contas e o servidor confere os valores da rodada 1.
+ */
+namespace Ed25519 {
+
+    const size_t POINT_BYTES = 32;
+    const size_t SCALAR_BYTES = 32;
+
+    // Elemento do corpo em 5 limbs de 51 bits (2^255 - 19 cabe com folga em u128)
+    struct Fe {
+        uint64_t v[5];
+    };
+
+    // Coordenadas estendidas: x = X/Z, y = Y/Z, x·y = T/Z
+    struct Point {
+        Fe X, Y, Z, T;
+    };
+
+    namespace detail {
+        using u128 = unsigned __int128;
+        const uint64_t MASK51 = (1ULL << 51) - 1;
+
+        inline uint64_t load64(const uint8_t* p) {
+            uint64_t v = 0;
+            for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+            return v;
+        }
+
+        inline void store64(uint8_t* p, uint64_t v) {
+            for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i));
+        }
+
+        inline Fe feFromInt(uint64_t n) { return {{n, 0, 0, 0, 0}}; }
+
+        // Redução fraca: limbs voltam para perto de 51 bits
+        inline void carry(Fe& h) {
+            uint64_t c;
+            c = h.v[0] >> 51; h.v[0] &= MASK51; h.v[1] += c;
+            c = h.v[1] >> 51; h.v[1] &= MASK51; h.v[2] += c;
+            c = h.v[2] >> 51; h.v[2] &= MASK51; h.v[3] += c;
+            c = h.v[3] >> 51; h.v[3] &= MASK51; h.v[4] += c;
+            c = h.v[4] >> 51; h.v[4] &= MASK51; h.v[0] += c * 19;
+        }
+
+        inline Fe feAdd(const Fe& a, const Fe& b) {
+            Fe h;
+            for (int i = 0; i < 5; ++i) h.v[i] = a.v[i] + b.v[i];
+            carry(h);
+            return h;
+        }
+
+        // a + 2p - b: nunca fica negativo com entradas já reduzidas
+        inline Fe feSub(const Fe& a, const Fe& b) {
+            Fe h;
+            h.v[0] = a.v[0] + 0xfffffffffffdaULL - b.v[0];
+            for (int i = 1; i < 5; ++i) h.v[i] = a.v[i] + 0xffffffffffffeULL - b.v[i];
+            carry(h);
+            return h;
+        }
+
+        inline Fe feNeg(const Fe& a) { return feSub(feFromInt(0), a); }
+
+        inline Fe feMul(const Fe& a, const Fe& b) {
+            uint64_t b1 = b.v[1] * 19, b2 = b.v[2] * 19, b3 = b.v[3] * 19, b4 = b.v[4] * 19;
+            u128 r0 = (u128)a.v[0] * b.v[0] + (u128)a.v[1] * b4 + (u128)a.v[2] * b3 + (u128)a.v[3] * b2 + (u128)a.v[4] * b1;
+            u128 r1 = (u128)a.v[0] * b.v[1] + (u128)a.v[1] * b.v[0] + (u128)a.v[2] * b4 + (u128)a.v[3] * b3 + (u128)a.v[4] * b2;
+            u128 r2 = (u128)a.v[0] * b.v[2] + (u128)a.v[1] * b.v[1] + (u128)a.v[2] * b.v[0] + (u128)a.v[3] * b4 + (u128)a.v[4] * b3;
+            u128 r3 = (u128)a.v[0] * b.v[3] + (u128)a.v[1] * b.v[2] + (u128)a.v[2] * b.v[1] + (u128)a.v[3] * b.v[0] + (u128)a.v[4] * b4;
+            u128 r4 = (u128)a.v[0] * b.v[4] + (u128)a.v[1] * b.v[3] + (u128)a.v[2] * b.v[2] + (u128)a.v[3] * b.v[1] + (u128)a.v[4] * b.v[0];
+            r1 += r0 >> 51;
+            r2 += r1 >> 51;
+            r3 += r2 >> 51;
+            r4 += r3 >> 51;
+            Fe h;
+            h.v[0] = ((uint64_t)r0 & MASK51) + (uint64_t)(r4 >> 51) * 19;
+            h.v[1] = (uint64_t)r1 & MASK51;
+            h.v[2] = (uint64_t)r2 & MASK51;
+            h.v[3] = (uint64_t)r3 & MASK51;
+            h.v[4] = (uint64_t)r4 & MASK51;
+            h.v[1] += h.v[0] >> 51;
+            h.v[0] &= MASK51;
+            return h;
+        }
+
+        inline Fe feSq(const Fe& a) { return feMul(a, a); }
+
+        // Expoente público de 256 bits em little-endian
+        inline Fe fePow(const Fe& a, const uint8_t exponent[32]) {
+            Fe result = feFromInt(1);
+            for (int i = 255; i >= 0; --i) {
+                result = feSq(result);
+                if ((exponent[i >> 3] >> (i & 7)) & 1) {
+                    result = feMul(result, a);
+                }
+            }
+            return result;
+        }
+
+        // 2^255 - 21 (p - 2), 2^252 - 3 ((p - 5) / 8) e 2^253 - 5 ((p - 1) / 4)
+        inline void exponentBytes(uint8_t out[32], uint8_t low, uint8_t high) {
+            memset(out, 0xff, 32);
+            out[0] = low;
+            out[31] = high;
+        }
+
+        inline Fe feInvert(const Fe& a) {
+            uint8_t e[32];
+            exponentBytes(e, 0xeb, 0x7f);
+            return fePow(a, e);
+        }
+
+        inline Fe feFromBytes(const uint8_t s[32]) {
+            Fe h;
+            h.v[0] = load64(s) & MASK51;
+            h.v[1] = (load64(s + 6) >> 3) & MASK51;
+            h.v[2] = (load64(s + 12) >> 6) & MASK51;
+            h.v[3] = (load64(s + 19) >> 1) & MASK51;
+            h.v[4] = (load64(s + 24) >> 12) & MASK51;
+            return h;
+        }
+
+        // Forma canônica: subtrai p uma vez se o valor ainda for >= p
+        inline void feToBytes(uint8_t s[32], const Fe& a) {
+            Fe t = a;
+            carry(t);
+            carry(t);
+            uint64_t q = (t.v[0] + 19) >> 51;
+            q = (t.v[1] + q) >> 51;
+            q = (t.v[2] + q) >> 51;
+            q = (t.v[3] + q) >> 51;
+            q = (t.v[4] + q) >> 51;
+            t.v[0] += 19 * q;
+            uint64_t c;
+            c = t.v[0] >> 51; t.v[0] &= MASK51; t.v[1] += c;
+            c = t.v[1] >> 51; t.v[1] &= MASK51; t.v[2] += c;
+            c = t.v[2] >> 51; t.v[2] &= MASK51; t.v[3] += c;
+            c = t.v[3] >> 51; t.v[3] &= MASK51; t.v[4] += c;
+            t.v[4] &= MASK51;
+            store64(s, t.v[0] | (t.v[1] << 51));
+            store64(s + 8, (t.v[1] >> 13) | (t.v[2] << 38));
+            store64(s + 16, (t.v[2] >> 26) | (t.v[3] << 25));
+            store64(s + 24, (t.v[3] >> 39) | (t.v[4] << 12));
+        }
+
+        inline bool feEqual(const Fe& a, const Fe& b) {
+            uint8_t sa[32], sb[32];
+            feToBytes(sa, a);
+            feToBytes(sb, b);
+            return memcmp(sa, sb, 32) == 0;
+        }
+
+        inline bool feIsZero(const Fe& a) { return feEqual(a, feFromInt(0)); }
+
+        inline bool feIsOdd(const Fe& a) {
+            uint8_t s[32];
+            feToBytes(s, a);
+            return s[0] & 1;
+        }
+
+        // Troca a e b sem desvio quando bit = 1
+        inline void feCswap(Fe& a, Fe& b, uint64_t bit) {
+            uint64_t mask = 0 - bit;
+            for (int i = 0; i < 5; ++i) {
+                uint64_t t = mask & (a.v[i] ^ b.v[i]);
+                a.v[i] ^= t;
+                b.v[i] ^= t;
+            }
+        }
+
+        struct Constants {
+            Fe d2;      // 2·d
+            Fe d;
+            Fe sqrtM1;  // sqrt(-1)
+        };
+
+        inline const Constants& constants() {
+            static const Constants c = [] {
+                Constants k;
+                // d = -121665 / 121666
+                k.d = feMul(feNeg(feFromInt(121665)), feInvert(feFromInt(121666)));
+                k.d2 = feAdd(k.d, k.d);
+                // 2 não é resíduo quadrático (p ≡ 5 mod 8), então 2^((p-1)/4)² = -1
+                uint8_t e[32];
+                exponentBytes(e, 0xfb, 0x1f);
+                k.sqrtM1 = fePow(feFromInt(2), e);
+                return k;
+            }();
+            return c;
+        }
+    }
+
+    inline Point identity() {
+        using namespace detail;
+        return {feFromInt(0), feFromInt(1), feFromInt(1), feFromInt(0)};
+    }
+
+    // Fórmula completa da RFC 8032 (5.1.4): vale também para P + P e para a identidade
+    inline Point add(const Point& p, const Point& q) {
+        using namespace detail;
+        Fe a = feMul(feSub(p.Y, p.X), feSub(q.Y, q.X));
+        Fe b = feMul(feAdd(p.Y, p.X), feAdd(q.Y, q.X));
+        Fe c = feMul(feMul(p.T, constants().d2), q.T);
+        Fe d = feMul(feAdd(p.Z, p.Z), q.Z);
+        Fe e = feSub(b, a), f = feSub(d, c), g = feAdd(d, c), h = feAdd(b, a);
+        return {feMul(e, f), feMul(g, h), feMul(f, g), feMul(e, h)};
+    }
+
+    inline Point negate(const Point& p) {
+        using namespace detail;
+        return {feNeg(p.X), p.Y, p.Z, feNeg(p.T)};
+    }
+
+    inline bool equal(const Point& p, const Point& q) {
+        using namespace detail;
+        return feEqual(feMul(p.X, q.Z), feMul(q.X, p.Z)) && feEqual(feMul(p.Y, q.Z), feMul(q.Y, p.Z));
+    }
+
+    inline bool isIdentity(const Point& p) { return equal(p, identity()); }
+
+    // y em little-endian com o bit de paridade de x no bit 255
+    inline void encode(uint8_t out[POINT_BYTES], const Point& p) {
+        using namespace detail;
+        Fe zInv = feInvert(p.Z);
+        Fe x = feMul(p.X, zInv), y = feMul(p.Y, zInv);
+        feToBytes(out, y);
+        out[31] |= (uint8_t)(feIsOdd(x) << 7);
+    }
+
+    // Falha se y não é canônico ou não existe x na curva (RFC 8032, 5.1.3)
+    inline bool decode(const uint8_t in[POINT_BYTES], Point& out) {
+        using namespace detail;
+        Fe y = feFromBytes(in);
+        uint8_t canonical[32];
+        feToBytes(canonical, y);
+        canonical[31] |= in[31] & 0x80;
+        if (memcmp(canonical, in, 32) != 0) {
+            return false;
+        }
+        bool sign = in[31] >> 7;
+
+        Fe y2 = feSq(y);
+        Fe u = feSub(y2, feFromInt(1));
+        Fe v = feAdd(feMul(constants().d, y2), feFromInt(1));
+        Fe v3 = feMul(feSq(v), v);
+        Fe v7 = feMul(feSq(v3), v);
+        uint8_t e[32];
+        exponentBytes(e, 0xfd, 0x0f);
+        Fe x = feMul(feMul(u, v3), fePow(feMul(u, v7), e));
+        Fe vx2 = feMul(v, feSq(x));
+        if (!feEqual(vx2, u)) {
+            if (!feEqual(vx2, feNeg(u))) {
+                return false;
+            }
+            x = feMul(x, constants().sqrtM1);
+        }
+        if (feIsZero(x) && sign) {
+            return false;
+        }
+        if (feIsOdd(x) != sign) {
+            x = feNeg(x);
+        }
+        out = {x, y, feFromInt(1), feMul(x, y)};
+        return true;
+    }
+
+    inline const Point& basePoint() {
+        static const Point base = [] {
+            // y = 4/5, x par
+            uint8_t bytes[POINT_BYTES];
+            memset(bytes, 0x66, sizeof(bytes));
+            bytes[0] = 0x58;
+            Point p;
+            decode(bytes, p);
+            return p;
+        }();
+        return base;
+    }
+
+    /**
+     * @brief [k]P para escalar secreto: escada de Montgomery sobre os 256 bits, sempre
+     * as mesmas duas somas por bit e trocas sem desvio, sem depender do valor de k.
+     */
+    inline Point scalarMult(const uint8_t k[SCALAR_BYTES], const Point& p) {
+        using namespace detail;
+        Point r0 = identity(), r1 = p;
+        for (int i = 255; i >= 0; --i) {
+            uint64_t bit = (k[i >> 3] >> (i & 7)) & 1;
+            feCswap(r0.X, r1.X, bit); feCswap(r0.Y, r1.Y, bit);
+            feCswap(r0.Z, r1.Z, bit); feCswap(r0.T, r1.T, bit);
+            r1 = add(r0, r1);
+            r0 = add(r0, r0);
+            feCswap(r0.X, r1.X, bit); feCswap(r0.Y, r1.Y, bit);
+            feCswap(r0.Z, r1.Z, bit); feCswap(r0.T, r1.T, bit);
+        }
+        return r0;
+    }
+
+    // [n]P para n público (tamanho do grupo, coeficientes do BD): dobra e soma simples
+    inline Point smallMult(uint64_t n, const Point& p) {
+        Point result = identity(), addend = p;
+        while (n > 0) {
+            if (n & 1) result = add(result, addend);
+            addend = add(addend, addend);
+            n >>= 1;
+        }
+        return result;
+    }
+
+    // Pontos de ordem 1, 2, 4 ou 8 não servem como chave pública
+    inline bool hasSmallOrder(const Point& p) { return isIdentity(smallMult(8, p)); }
+
+    // ========================================================================
+    // Escalares módulo l = 2^252 + 27742317777372353535851937790883648493, a ordem de B
+    // ========================================================================
+
+    namespace detail {
+        const uint64_t ORDER[4] = {0x5812631a5cf5d3edULL, 0x14def9dea2f79cd6ULL, 0, 0x1000000000000000ULL};
+
+        inline void scalarStore(uint8_t out[SCALAR_BYTES], const uint64_t limbs[4]) {
+            for (int i = 0; i < 4; ++i) store64(out + 8 * i, limbs[i]);
+        }
+    }
+
+    /**
+     * @brief 'length' bytes little-endian reduzidos módulo l, um bit por vez e sem desvio
+     * (as entradas podem ser segredos). Serve para até 512 bits (produtos e hashes).
+     */
+    inline void scalarReduce(const uint8_t* in, size_t length, uint8_t out[SCALAR_BYTES]) {
+        using namespace detail;
+        uint64_t acc[4] = {0, 0, 0, 0};
+        for (size_t i = length * 8; i-- > 0;) {
+            // acc < l < 2^253, então 2·acc + 1 ainda cabe em 4 limbs
+            acc[3] = (acc[3] << 1) | (acc[2] >> 63);
+            acc[2] = (acc[2] << 1) | (acc[1] >> 63);
+            acc[1] = (acc[1] << 1) | (acc[0] >> 63);
+            acc[0] = (acc[0] << 1) | ((in[i >> 3] >> (i & 7)) & 1);
+            uint64_t diff[4], borrow = 0;
+            for (int j = 0; j < 4; ++j) {
+                u128 d = (u128)acc[j] - ORDER[j] - borrow;
+                diff[j] = (uint64_t)d;
+                borrow = (uint64_t)(d >> 64) & 1;
+            }
+            // Sem empréstimo, acc >= l: fica a diferença
+            uint64_t keep = 0 - borrow;
+            for (int j = 0; j < 4; ++j) acc[j] = (acc[j] & keep) | (diff[j] & ~keep);
+        }
+        scalarStore(out, acc);
+    }
+
+    // Escalar já reduzido: rejeita s >= l (a mesma prova não pode ter duas codificações)
+    inline bool scalarIsCanonical(const uint8_t s[SCALAR_BYTES]) {
+        uint8_t reduced[SCALAR_BYTES];
+        scalarReduce(s, SCALAR_BYTES, reduced);
+        return memcmp(reduced, s, SCALAR_BYTES) == 0;
+    }
+
+    // out = (k - c·r) mod l, a resposta de uma prova de Schnorr / Chaum-Pedersen
+    inline void scalarMulSub(uint8_t out[SCALAR_BYTES], const uint8_t k[SCALAR_BYTES],
+                             const uint8_t c[SCALAR_BYTES], const uint8_t r[SCALAR_BYTES]) {
+        using namespace detail;
+        uint64_t a[4], b[4], product[8] = {0};
+        for (int i = 0; i < 4; ++i) {
+            a[i] = load64(c + 8 * i);
+            b[i] = load64(r + 8 * i);
+        }
+        for (int i = 0; i < 4; ++i) {
+            u128 carry = 0;
+            for (int j = 0; j < 4; ++j) {
+                u128 t = (u128)a[i] * b[j] + product[i + j] + carry;
+                product[i + j] = (uint64_t)t;
+                carry = t >> 64;
+            }
+            product[i + 4] = (uint64_t)carry;
+        }
+        uint8_t bytes[64], cr[SCALAR_BYTES], kr[SCALAR_BYTES];
+        for (int i = 0; i < 8; ++i) store64(bytes + 8 * i, product[i]);
+        scalarReduce(bytes, sizeof(bytes), cr);
+        scalarReduce(k, SCALAR_BYTES, kr);
+
+        // k + (l - c·r) < 2l < 2^254
+        uint64_t sum[4], borrow = 0;
+        u128 carry = 0;
+        for (int i = 0; i < 4; ++i) {
+            u128 d = (u128)ORDER[i] - load64(cr + 8 * i) - borrow;
+            borrow = (uint64_t)(d >> 64) & 1;
+            u128 t = (u128)(uint64_t)d + load64(kr + 8 * i) + carry;
+            sum[i] = (uint64_t)t;
+            carry = t >> 64;
+        }
+        scalarStore(bytes, sum);
+        scalarReduce(bytes, SCALAR_BYTES, out);
+    }
+
+    // [a]P + [b]Q para escalares públicos (verificação): truque de Shamir, tempo variável
+    inline Point doubleScalarMultVartime(const uint8_t a[SCALAR_BYTES], const Point& p,
+                                         const uint8_t b[SCALAR_BYTES], const Point& q) {
+        Point both = add(p, q), result = identity();
+        for (int i = 255; i >= 0; --i) {
+            result = add(result, result);
+            bool bitA = (a[i >> 3] >> (i & 7)) & 1, bitB = (b[i >> 3] >> (i & 7)) & 1;
+            if (bitA && bitB) result = add(result, both);
+            else if (bitA) result = add(result, p);
+            else if (bitB) result = add(result, q);
+        }
+        return result;
+    }
+
+    // Está no subgrupo gerado por B ([l]P = identidade), sem componente de torção
+    inline bool inPrimeOrderSubgroup(const Point& p) {
+        uint8_t order[SCALAR_BYTES];
+        detail::scalarStore(order, detail::ORDER);
+        return isIdentity(scalarMult(order, p));
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace CryptoUtils {
+
+    using Sha256Digest = std::array<uint8_t, 32>;
+
+    /**
+     * @brief SHA-256 (FIPS 180-4) incremental: update() quantas vezes for preciso e
+     * finish() uma vez. Base do ratchet de chaves do grupo. Só cabeçalho: o servidor
+     * também usa, para conferir as provas da rodada 1.
+     */
+    class Sha256 {
+    public:
+        Sha256();
+        void update(const void* data, size_t length);
+        Sha256Digest finish();
+
+    private:
+        uint32_t state[8];
+        uint8_t block[64];
+        size_t blockLength = 0;
+        uint64_t totalLength = 0;
+
+        void compress(const uint8_t* chunk);
+    };
+
+    Sha256Digest sha256(const std::string& data);
+
+    Sha256Digest hmacSha256(const uint8_t* key, size_t keyLength, const uint8_t* data, size_t length);
+
+    /**
+     * @brief HKDF-SHA256 (RFC 5869): extrai de 'ikm' com 'salt' e expande para
+     * 'outLength' bytes (no máximo 255 * 32) ligados ao contexto 'info'.
+     */
+    void hkdfSha256(const std::string& salt, const uint8_t* ikm, size_t ikmLength, const std::string& info,
+                    uint8_t* out, size_t outLength);
+
+    namespace detail {
+        inline const uint32_t ROUND_CONSTANTS[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+    }
+
+    inline Sha256::Sha256()
+        : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19} {}
+
+    inline void Sha256::compress(const uint8_t* chunk) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t)chunk[4 * i] << 24 | (uint32_t)chunk[4 * i + 1] << 16 |
+                   (uint32_t)chunk[4 * i + 2] << 8 | chunk[4 * i + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = detail::rotr(w[i - 15], 7) ^ detail::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = detail::rotr(w[i - 2], 17) ^ detail::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (detail::rotr(e, 6) ^ detail::rotr(e, 11) ^ detail::rotr(e, 25)) + ((e & f) ^ (~e & g)) + detail::ROUND_CONSTANTS[i] + w[i];
+            uint32_t t2 = (detail::rotr(a, 2) ^ detail::rotr(a, 13) ^ detail::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    inline void Sha256::update(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalLength += length;
+        while (length > 0) {
+            size_t take = std::min(length, sizeof(block) - blockLength);
+            memcpy(block + blockLength, bytes, take);
+            blockLength += take;
+            bytes += take;
+            length -= take;
+            if (blockLength == sizeof(block)) {
+                compress(block);
+                blockLength = 0;
+            }
+        }
+    }
+
+    inline Sha256Digest Sha256::finish() {
+        uint64_t bits = totalLength * 8;
+        uint8_t padding = 0x80;
+        update(&padding, 1);
+        padding = 0;
+        while (blockLength != 56) {
+            update(&padding, 1);
+        }
+        uint8_t length[8];
+        for (int i = 0; i < 8; ++i) {
+            length[i] = (uint8_t)(bits >> (56 - 8 * i));
+        }
+        update(length, sizeof(length));
+
+        Sha256Digest digest;
+        for (int i = 0; i < 8; ++i) {
+            digest[4 * i] = (uint8_t)(state[i] >> 24);
+            digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+            digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+            digest[4 * i + 3] = (uint8_t)state[i];
+        }
+        return digest;
+    }
+
+    inline Sha256Digest sha256(const std::string& data) {
+        Sha256 hash;
+        hash.update(data.data(), data.size());
+        return hash.finish();
+    }
+
+    inline Sha256Digest hmacSha256(const uint8_t* key, size_t keyLength, const uint8_t* data, size_t length) {
+        uint8_t block[64] = {0};
+        if (keyLength > sizeof(block)) {
+            Sha256 hash;
+            hash.update(key, keyLength);
+            Sha256Digest digest = hash.finish();
+            memcpy(block, digest.data(), digest.size());
+        } else {
+            memcpy(block, key, keyLength);
+        }
+
+        uint8_t pad[64];
+        for (size_t i = 0; i < sizeof(pad); ++i) {
+            pad[i] = block[i] ^ 0x36;
+        }
+        Sha256 inner;
+        inner.update(pad, sizeof(pad));
+        inner.update(data, length);
+        Sha256Digest innerDigest = inner.finish();
+
+        for (size_t i = 0; i < sizeof(pad); ++i) {
+            pad[i] = block[i] ^ 0x5c;
+        }
+        Sha256 outer;
+        outer.update(pad, sizeof(pad));
+        outer.update(innerDigest.data(), innerDigest.size());
+        return outer.finish();
+    }
+
+    inline void hkdfSha256(const std::string& salt, const uint8_t* ikm, size_t ikmLength, const std::string& info,
+                    uint8_t* out, size_t outLength) {
+        Sha256Digest prk = hmacSha256((const uint8_t*)salt.data(), salt.size(), ikm, ikmLength);
+
+        // T(i) = HMAC(PRK, T(i-1) || info || i)
+        std::string input;
+        Sha256Digest t;
+        size_t tLength = 0;
+        for (uint8_t counter = 1; outLength > 0; ++counter) {
+            input.assign((const char*)t.data(), tLength);
+            input += info;
+            input += (char)counter;
+            t = hmacSha256(prk.data(), prk.size(), (const uint8_t*)input.data(), input.size());
+            tLength = t.size();
+            size_t take = std::min(outLength, t.size());
+            memcpy(out, t.data(), take);
+            out += take;
+            outLength -= take;
+        }
+    }
+}
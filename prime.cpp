@@ -4,30 +4,38 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 class SafePrimeGenerator {
 public:
     std::mt19937 rng;
     
-    // Teste de primalidade de Miller-Rabin
-    bool millerRabinTest(uint32_t n, int rounds = 10) {
+    // Teste de primalidade de Miller-Rabin determinístico: com essas bases não há
+    // pseudoprimo fortes abaixo de 2^32 ({2, 7, 61}) nem abaixo de 2^64 (primos até 37)
+    bool millerRabinTest(uint64_t n) {
+        static const uint64_t SMALL_PRIMES[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
         if (n < 2) return false;
-        if (n == 2 || n == 3) return true;
-        if (n % 2 == 0) return false;
+        for (uint64_t p : SMALL_PRIMES) {
+            if (n % p == 0) return n == p;
+        }
         
         // Escreve n-1 como d * 2^r
-        uint32_t d = n - 1;
+        uint64_t d = n - 1;
         int r = 0;
         while (d % 2 == 0) {
             d /= 2;
             r++;
         }
         
-        std::uniform_int_distribution<uint32_t> dist(2, n - 2);
+        static const uint64_t BASES_32[] = {2, 7, 61};
+        const uint64_t* bases = n < (1ULL << 32) ? BASES_32 : SMALL_PRIMES;
+        size_t count = n < (1ULL << 32) ? 3 : 12;
         
-        for (int i = 0; i < rounds; i++) {
-            uint32_t a = dist(rng);
-            uint64_t x = modPow(a, d, n);
+        for (size_t i = 0; i < count; i++) {
+            if (bases[i] % n == 0) continue;  // Base 61 com n <= 61
+            uint64_t x = modPow(bases[i], d, n);
             
             if (x == 1 || x == n - 1) continue;
             
@@ -94,17 +102,17 @@ public:
         return result;
     }
     
-    // Multiplicação modular para evitar overflow
+    // Multiplicação modular para evitar overflow: o produto de dois valores de 64 bits cabe em __int128
     uint64_t modMul(uint64_t a, uint64_t b, uint64_t mod) {
-        return ((uint64_t)a * b) % mod;
+        return (uint64_t)((unsigned __int128)a * b % mod);
     }
     
     // Verifica se um número é primo seguro
-    bool isSafePrime(uint32_t p) {
+    bool isSafePrime(uint64_t p) {
         if (!millerRabinTest(p)) return false;
         
         // Verifica se (p-1)/2 também é primo (primo de Sophie Germain)
-        uint32_t q = (p - 1) / 2;
+        uint64_t q = (p - 1) / 2;
         return millerRabinTest(q);
     }
     
@@ -188,34 +196,47 @@ public:
     
     // Gera um primo seguro de 32 bits
     uint32_t generateSafePrime() {
-        // Define o intervalo para números de 32 bits
-        uint32_t min = 0x80000000UL; // Menor número de 32 bits
-        uint32_t max = 0xFFFFFFFFUL; // Maior número de 32 bits
-        
-        // Garante que começamos com um número ímpar
-        if (min % 2 == 0) min++;
-        
-        uint32_t candidate;
-        int attempts = 0;
-        const int maxAttempts = 500000; // Aumentado para 32 bits
-        
-        std::cout << "Gerando primo seguro de 32 bits..." << std::endl;
+        return (uint32_t)generateSafePrime(32);
+    }
+    
+    /**
+     * Gera um primo seguro p = 2q + 1 com exatamente 'bits' bits (16 a 64).
+     *
+     * Em vez de testar candidatos soltos, cada thread sorteia um trecho de q's ímpares
+     * consecutivos e risca com primos pequenos quem tem q ou 2q + 1 divisível por eles;
+     * o Miller-Rabin só roda nos que sobram (cerca de 1 em 110 no trecho). A primeira
+     * thread que acha um par primo vence e as outras param.
+     */
+    uint64_t generateSafePrime(int bits, unsigned workers = 0) {
+        if (bits < 16 || bits > 64) {
+            throw std::invalid_argument("O primo seguro deve ter entre 16 e 64 bits");
+        }
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
         
-        do {
-            candidate = generateRandomOdd(min, max);
-            attempts++;
-            
-            if (attempts % 10000 == 0) {
-                std::cout << "Tentativa " << attempts << "..." << std::endl;
-            }
-            
-            if (attempts > maxAttempts) {
-                throw std::runtime_error("Não foi possível encontrar um primo seguro após muitas tentativas");
-            }
-        } while (!isSafePrime(candidate));
+        // p com 'bits' bits <=> q em [2^(bits-2), 2^(bits-1) - 1]
+        const uint64_t qMin = 1ULL << (bits - 2);
+        const uint64_t qMax = (1ULL << (bits - 1)) - 1;
+        const std::vector<uint32_t> sievePrimes = smallPrimes(std::min<uint64_t>(SIEVE_LIMIT, qMin));
+        
+        std::cout << "Gerando primo seguro de " << bits << " bits com " << workers << " threads..." << std::endl;
+        
+        std::atomic<uint64_t> found{0};
+        std::atomic<uint64_t> tested{0};
+        std::vector<std::thread> threads;
+        for (unsigned w = 0; w < workers; w++) {
+            uint64_t seed = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}();
+            threads.emplace_back([this, &found, &tested, &sievePrimes, qMin, qMax, seed] {
+                searchSafePrime(found, tested, sievePrimes, qMin, qMax, seed);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
         
-        std::cout << "Primo encontrado após " << attempts << " tentativas!" << std::endl;
-        return candidate;
+        std::cout << "Primo encontrado após " << tested.load() << " testes de Miller-Rabin!" << std::endl;
+        return found.load();
     }
     
     // Verifica se um número dado é primo seguro
@@ -258,6 +279,63 @@ public:
         
         return roots;
     }
+
+private:
+    static const uint32_t SIEVE_LIMIT = 1 << 14;   // Primos pequenos usados no crivo
+    static const uint32_t SEGMENT_SIZE = 1 << 14;  // q's ímpares por trecho de cada thread
+    
+    // Primos ímpares menores que 'limit' (crivo de Eratóstenes)
+    static std::vector<uint32_t> smallPrimes(uint64_t limit) {
+        std::vector<bool> composite(limit, false);
+        std::vector<uint32_t> primes;
+        for (uint64_t i = 3; i < limit; i += 2) {
+            if (composite[i]) continue;
+            primes.push_back((uint32_t)i);
+            for (uint64_t j = i * i; j < limit; j += 2 * i) {
+                composite[j] = true;
+            }
+        }
+        return primes;
+    }
+    
+    // Trabalho de uma thread: sorteia trechos até alguma thread achar o primo
+    void searchSafePrime(std::atomic<uint64_t>& found, std::atomic<uint64_t>& tested,
+                         const std::vector<uint32_t>& sievePrimes, uint64_t qMin, uint64_t qMax, uint64_t seed) {
+        std::mt19937_64 local(seed);
+        // Base ímpar em qualquer ponto do intervalo; perto do fim o trecho é cortado em qMax
+        std::uniform_int_distribution<uint64_t> dist(qMin, qMax);
+        std::vector<uint8_t> crossed(SEGMENT_SIZE);
+        
+        while (found.load(std::memory_order_relaxed) == 0) {
+            uint64_t base = dist(local) | 1;
+            std::fill(crossed.begin(), crossed.end(), 0);
+            
+            // q = base + 2i. Para cada primo s, riscam-se os i com q = 0 (mod s), q composto,
+            // e com q = (s-1)/2 (mod s), que dá 2q + 1 = 0 (mod s)
+            for (uint32_t s : sievePrimes) {
+                uint64_t r = base % s;
+                uint64_t inv2 = (s + 1) / 2;  // Inverso de 2 módulo s
+                uint64_t first = (s - r) % s * inv2 % s;
+                uint64_t second = ((s - 1) / 2 + s - r) % s * inv2 % s;
+                for (uint64_t i = first; i < SEGMENT_SIZE; i += s) crossed[i] = 1;
+                for (uint64_t i = second; i < SEGMENT_SIZE; i += s) crossed[i] = 1;
+            }
+            
+            uint64_t count = 0;
+            for (uint32_t i = 0; i < SEGMENT_SIZE; i++) {
+                if (crossed[i]) continue;
+                uint64_t q = base + 2ULL * i;
+                if (q > qMax || found.load(std::memory_order_relaxed) != 0) break;
+                count++;
+                if (!millerRabinTest(q) || !millerRabinTest(2 * q + 1)) continue;
+                uint64_t expected = 0;
+                found.compare_exchange_strong(expected, 2 * q + 1);
+                break;
+            }
+            tested.fetch_add(count, std::memory_order_relaxed);
+            if (found.load(std::memory_order_relaxed) != 0) break;
+        }
+    }
 };
 
 // Estrutura para armazenar primo seguro com geradores
@@ -0,0 +1,64 @@
+#include "actor.h"
+
+#include <iostream>
+
+// Rede de segurança para o instante em que um push ainda não ficou visível ao consumidor
+static const std::chrono::milliseconds IDLE_WAIT(10);
+
+Actor::Actor(std::string name) : name(std::move(name)) {}
+
+Actor::~Actor() {
+    stop();
+}
+
+void Actor::start() {
+    running = true;
+    worker = std::thread(&Actor::run, this);
+}
+
+void Actor::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_one();
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void Actor::post(Task task) {
+    mailbox.push(std::move(task));
+    // Só paga o lock quando o consumidor está de fato dormindo
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_one();
+    }
+}
+
+void Actor::run() {
+    Task task;
+    while (true) {
+        if (mailbox.pop(task)) {
+            try {
+                task();
+            } catch (const std::exception& e) {
+                std::cerr << "Actor " << name << ": task failed: " << e.what() << std::endl;
+            }
+            task = nullptr;
+            continue;
+        }
+        if (!running) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping = true;
+        if (mailbox.empty() && running) {
+            wakeup.wait_for(lock, IDLE_WAIT);
+        }
+        sleeping = false;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mpscqueue.h"
+
+/**
+ * @brief Executa tarefas em uma única thread, na ordem em que foram postadas.
+ *
+ * Todo estado que só é tocado por tarefas do ator dispensa locks: as threads de
+ * conexão e os timers apenas postam comandos na caixa de entrada (MPSC lock-free).
+ */
+class Actor {
+public:
+    using Task = std::function<void()>;
+
+    explicit Actor(std::string name);
+    ~Actor();
+
+    void start();
+    // Executa o que já está na fila e encerra a thread
+    void stop();
+    void post(Task task);
+
+private:
+    std::string name;
+    MpscQueue<Task> mailbox;
+    std::atomic<bool> running{false};
+    std::atomic<bool> sleeping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+
+    void run();
+};
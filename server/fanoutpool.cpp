@@ -0,0 +1,109 @@
+#include "fanoutpool.h"
+
+#include <algorithm>
+
+FanoutPool::FanoutPool(int workerCount) {
+    for (int i = 0; i < workerCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&FanoutPool::workerLoop, this, i);
+    }
+}
+
+FanoutPool::~FanoutPool() {
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void FanoutPool::parallelFor(size_t count, size_t grain, const Job& job) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t partitions = (count + grain - 1) / grain;
+    if (queues.empty() || partitions == 1) {
+        job(0, count);
+        return;
+    }
+
+    Batch batch;
+    batch.remaining = partitions;
+    // Conta antes de enfileirar para o contador nunca ficar abaixo do que está nas filas
+    queued += partitions;
+
+    // Distribui em rodízio a partir de uma fila diferente a cada chamada
+    size_t start = nextQueue.fetch_add(1);
+    for (size_t p = 0; p < partitions; ++p) {
+        WorkQueue& queue = *queues[(start + p) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.partitions.push_back({&job, p * grain, std::min(count, (p + 1) * grain), &batch});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_all();
+    }
+
+    // Ajuda enquanto espera; quando não há mais o que roubar, só falta o que já está rodando
+    Partition partition;
+    while (batch.remaining.load() > 0) {
+        if (steal(-1, partition)) {
+            execute(partition);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void FanoutPool::workerLoop(int self) {
+    Partition partition;
+    while (running) {
+        if (popOwn(self, partition) || steal(self, partition)) {
+            execute(partition);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeup.wait(lock, [this] { return !running || queued.load() > 0; });
+    }
+}
+
+bool FanoutPool::popOwn(int self, Partition& out) {
+    WorkQueue& queue = *queues[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.partitions.empty()) {
+        return false;
+    }
+    out = queue.partitions.front();
+    queue.partitions.pop_front();
+    queued--;
+    return true;
+}
+
+bool FanoutPool::steal(int self, Partition& out) {
+    for (size_t i = 0; i < queues.size(); ++i) {
+        if ((int)i == self) {
+            continue;
+        }
+        WorkQueue& queue = *queues[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.partitions.empty()) {
+            out = queue.partitions.back();
+            queue.partitions.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void FanoutPool::execute(const Partition& partition) {
+    (*partition.job)(partition.begin, partition.end);
+    // Depois deste decremento o Batch (na pilha de quem chamou) pode deixar de existir
+    partition.batch->remaining.fetch_sub(1);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Pool de threads para distribuir um broadcast grande em partições.
+ *
+ * parallelFor() divide o intervalo em partições e as espalha pelas filas dos
+ * workers; quem fica sem trabalho rouba partições do fim da fila de outro worker.
+ * Quem chama também executa partições enquanto espera, então a chamada só retorna
+ * quando o intervalo inteiro foi processado (o snapshot lido continua válido).
+ */
+class FanoutPool {
+public:
+    using Job = std::function<void(size_t begin, size_t end)>;
+
+    explicit FanoutPool(int workers);
+    ~FanoutPool();
+
+    FanoutPool(const FanoutPool&) = delete;
+    FanoutPool& operator=(const FanoutPool&) = delete;
+
+    void parallelFor(size_t count, size_t grain, const Job& job);
+
+    int workerCount() const { return (int)queues.size(); }
+
+private:
+    struct Batch {
+        std::atomic<size_t> remaining{0};
+    };
+
+    struct Partition {
+        const Job* job;
+        size_t begin;
+        size_t end;
+        Batch* batch;
+    };
+
+    // Cada worker consome a frente da própria fila; ladrões levam do fim
+    struct alignas(64) WorkQueue {
+        std::mutex mutex;
+        std::deque<Partition> partitions;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{true};
+    std::atomic<size_t> queued{0};  // Partições ainda em alguma fila
+    std::atomic<size_t> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+
+    void workerLoop(int self);
+    bool popOwn(int self, Partition& out);
+    bool steal(int self, Partition& out);
+    static void execute(const Partition& partition);
+};
@@ -0,0 +1,75 @@
+#include "latencyhistogram.h"
+
+#include <sstream>
+
+int LatencyHistogram::bucketFor(uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return (int)micros;
+    }
+    int exponent = 63 - __builtin_clzll(micros);
+    int sub = (int)((micros >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::upperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    int sub = bucket % SUB_BUCKETS;
+    uint64_t base = 1ULL << exponent;
+    uint64_t step = base >> SUB_BITS;
+    return base + (sub + 1) * step - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t seen = maxSeen.load(std::memory_order_relaxed);
+    while (micros > seen && !maxSeen.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p / 100.0 * n);
+    if (rank >= n) {
+        rank = n - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            uint64_t bound = upperBound(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+}
+
+static std::string formatMicros(uint64_t micros) {
+    std::ostringstream out;
+    out.precision(3);
+    if (micros < 1000) {
+        out << micros << "us";
+    } else if (micros < 1000000) {
+        out << micros / 1000.0 << "ms";
+    } else {
+        out << micros / 1000000.0 << "s";
+    }
+    return out.str();
+}
+
+std::string LatencyHistogram::summary() const {
+    std::ostringstream out;
+    out << "n=" << count()
+        << " p50=" << formatMicros(percentile(50))
+        << " p90=" << formatMicros(percentile(90))
+        << " p99=" << formatMicros(percentile(99))
+        << " max=" << formatMicros(max());
+    return out.str();
+}
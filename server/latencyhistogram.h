@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Histograma de latências em microssegundos com buckets log-lineares.
+ *
+ * Cada potência de 2 é dividida em 4 sub-buckets (erro relativo < 25%). O registro
+ * é lock-free, então qualquer thread pode alimentar o histograma.
+ */
+class LatencyHistogram {
+public:
+    void record(uint64_t micros);
+    // Limite superior (us) do bucket que contém o percentil p (0-100)
+    uint64_t percentile(double p) const;
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxSeen.load(std::memory_order_relaxed); }
+    // Ex.: "n=120 p50=410us p90=820us p99=1.6ms max=2.1ms"
+    std::string summary() const;
+
+private:
+    static const int SUB_BITS = 2;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = 64 * SUB_BUCKETS;
+
+    std::atomic<uint64_t> buckets[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maxSeen{0};
+
+    static int bucketFor(uint64_t micros);
+    static uint64_t upperBound(int bucket);
+};
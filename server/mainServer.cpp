@@ -1,8 +1,53 @@
 #include "server.cpp"
+#include <cstdlib>
 
-int main()
+int main(int argc, char* argv[])
 {
-    Server server(8080);
+    ServerConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        long value = atol(argv[i + 1]);
+        if (option == "--port") {
+            config.port = value;
+        } else if (option == "--heartbeat-ms") {
+            config.heartbeatInterval = chrono::milliseconds(value);
+        } else if (option == "--heartbeat-misses") {
+            config.maxMissedHeartbeats = value;
+        } else if (option == "--fanout-threads") {
+            config.fanoutThreads = value;
+        } else if (option == "--fanout-threshold") {
+            config.fanoutThreshold = value;
+        } else if (option == "--room-executors") {
+            config.roomExecutors = value;
+        } else if (option == "--client-msg-rate") {
+            config.clientMessageRate = value;
+        } else if (option == "--client-byte-rate") {
+            config.clientByteRate = value;
+        } else if (option == "--room-msg-rate") {
+            config.roomMessageRate = value;
+        } else if (option == "--room-byte-rate") {
+            config.roomByteRate = value;
+        } else if (option == "--overload-backlog") {
+            config.overloadBacklog = value;
+        } else if (option == "--history-dir") {
+            config.historyDir = argv[i + 1];
+        } else if (option == "--history-segment-bytes") {
+            config.historySegmentBytes = value;
+        } else if (option == "--history-max-bytes") {
+            config.historyMaxBytes = value;
+        } else if (option == "--history-max-age-s") {
+            config.historyMaxAge = chrono::seconds(value);
+        } else if (option == "--resume-grace-ms") {
+            config.resumeGrace = chrono::milliseconds(value);
+        } else if (option == "--fast-join-limit") {
+            config.fastJoinLimit = value;
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 1;
+        }
+    }
+
+    Server server(config);
     server.run();
     return 0;
 }
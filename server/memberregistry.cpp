@@ -0,0 +1,67 @@
+#include "memberregistry.h"
+
+MemberId MemberRegistry::add(const std::string& username, const nlohmann::json& publicKey, int slot) {
+    if (byName.count(username)) {
+        return NO_MEMBER;
+    }
+
+    MemberId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = members.size();
+        members.emplace_back();
+        active.push_back(false);
+    }
+
+    Member& member = members[id];
+    member.username = username;
+    member.publicKey = publicKey;
+    member.slot = slot;
+    member.ringIndex = order.size();
+
+    // Entra no fim do anel: entre o último e o primeiro
+    if (order.empty()) {
+        member.before = id;
+        member.after = id;
+    } else {
+        MemberId first = order.front();
+        MemberId last = order.back();
+        member.before = last;
+        member.after = first;
+        members[last].after = id;
+        members[first].before = id;
+    }
+
+    order.push_back(id);
+    active[id] = true;
+    byName[username] = id;
+    return id;
+}
+
+void MemberRegistry::remove(MemberId id) {
+    if (!contains(id)) {
+        return;
+    }
+
+    Member& member = members[id];
+    members[member.before].after = member.after;
+    members[member.after].before = member.before;
+
+    // Quem vinha depois no anel anda uma posição para trás
+    order.erase(order.begin() + member.ringIndex);
+    for (uint32_t i = member.ringIndex; i < order.size(); ++i) {
+        members[order[i]].ringIndex = i;
+    }
+
+    byName.erase(member.username);
+    member.username.clear();
+    active[id] = false;
+    freeIds.push_back(id);
+}
+
+MemberId MemberRegistry::find(const std::string& username) const {
+    auto found = byName.find(username);
+    return found == byName.end() ? NO_MEMBER : found->second;
+}
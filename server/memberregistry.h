@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using MemberId = uint32_t;
+const MemberId NO_MEMBER = UINT32_MAX;
+
+struct Member {
+    std::string username;
+    nlohmann::json publicKey; // Opaca para o servidor: número (MODP) ou ponto em base64
+    int slot;                 // Slot (thread) da conexão do membro
+    uint32_t ringIndex;       // Posição no anel do Burmester-Desmedt
+    MemberId before;          // Vizinho anterior no anel
+    MemberId after;           // Vizinho seguinte no anel
+};
+
+/**
+ * @brief Registro dos membros do grupo com buscas O(1) nos dois sentidos.
+ *
+ * Os usernames são internados em IDs densos (reaproveitados após a saída), então o
+ * resto do servidor guarda e compara inteiros. A ordem do anel é a ordem de entrada,
+ * a mesma que os clientes reconstroem a partir dos deltas de membros; cada membro
+ * guarda sua posição e seus vizinhos, então as rodadas não precisam procurar ninguém.
+ */
+class MemberRegistry {
+public:
+    // Retorna NO_MEMBER se o username já estiver em uso
+    MemberId add(const std::string& username, const nlohmann::json& publicKey, int slot);
+    void remove(MemberId id);
+
+    MemberId find(const std::string& username) const;
+    bool contains(MemberId id) const { return id < members.size() && active[id]; }
+    const Member& get(MemberId id) const { return members[id]; }
+    // A conexão do membro mudou de slot (retomada de sessão); o anel não muda
+    void moveToSlot(MemberId id, int slot) { members[id].slot = slot; }
+
+    // IDs na ordem do anel
+    const std::vector<MemberId>& ring() const { return order; }
+    size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+
+private:
+    std::vector<Member> members;        // Indexado por MemberId
+    std::vector<bool> active;
+    std::vector<MemberId> freeIds;
+    std::vector<MemberId> order;
+    std::unordered_map<std::string, MemberId> byName;
+};
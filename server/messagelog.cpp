@@ -0,0 +1,308 @@
+#include "messagelog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t INDEX_INTERVAL = 4096;  // Bytes de log entre duas entradas do índice
+const size_t RECORD_ALIGN = 8;
+
+struct RecordHeader {
+    uint32_t length;       // Bytes do frame, incluindo o '\n' (0 = fim do segmento)
+    uint32_t reserved;
+    uint64_t seq;
+    uint64_t epoch;
+    int64_t appendedAtMs;  // Relógio de parede, para a retenção sobreviver a reinícios
+};
+
+struct IndexEntry {
+    uint64_t seq;
+    uint64_t offset;
+};
+
+size_t recordSize(size_t frameLength) {
+    size_t size = sizeof(RecordHeader) + frameLength;
+    return (size + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+// Mapeia o arquivo inteiro com 'capacity' bytes, criando ou aumentando se preciso
+void* mapFile(const std::string& path, size_t capacity) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, capacity) == 0) {
+        data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);  // O mapeamento continua válido sem o descritor
+    return data == MAP_FAILED ? nullptr : data;
+}
+
+}
+
+struct MessageLog::Segment {
+    uint64_t baseSeq = 0;
+    std::string logPath;
+    std::string indexPath;
+    char* log = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;           // Bytes já gravados (publicados sob o mutex do log)
+    IndexEntry* index = nullptr;
+    size_t indexCapacity = 0;
+    size_t indexCount = 0;
+    uint64_t lastSeq = 0;      // 0 = segmento vazio
+    int64_t lastAppendMs = 0;
+
+    ~Segment() {
+        if (log) {
+            munmap(log, capacity);
+        }
+        if (index) {
+            munmap(index, indexCapacity * sizeof(IndexEntry));
+        }
+    }
+
+    void addRecord(const RecordHeader& header, size_t offset) {
+        if (indexCount == 0 || offset - index[indexCount - 1].offset >= INDEX_INTERVAL) {
+            if (indexCount < indexCapacity) {
+                index[indexCount++] = {header.seq, offset};
+            }
+        }
+        lastSeq = header.seq;
+        lastAppendMs = header.appendedAtMs;
+        size = offset + recordSize(header.length);
+    }
+};
+
+MessageLog::MessageLog(const std::string& directory, const Limits& limits)
+    : directory(directory), limits(limits) {
+    if (directory.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "History disabled for " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+    persistent = true;
+
+    std::vector<uint64_t> bases;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".log") {
+            try {
+                bases.push_back(std::stoull(entry.path().stem().string()));
+            } catch (const std::exception&) {
+                // Arquivo que não é um segmento
+            }
+        }
+    }
+    std::sort(bases.begin(), bases.end());
+
+    for (uint64_t base : bases) {
+        std::shared_ptr<Segment> segment = openSegment(base, false);
+        if (!segment) {
+            continue;
+        }
+        segments[base] = segment;
+        totalBytes += segment->size;
+        nextSeq = segment->lastSeq != 0 ? segment->lastSeq + 1 : std::max(nextSeq, base);
+    }
+
+    if (segments.empty()) {
+        roll(nextSeq);
+    }
+}
+
+MessageLog::~MessageLog() = default;
+
+std::shared_ptr<MessageLog::Segment> MessageLog::openSegment(uint64_t baseSeq, bool create) {
+    char name[32];
+    snprintf(name, sizeof(name), "%020llu", (unsigned long long)baseSeq);
+
+    auto segment = std::make_shared<Segment>();
+    segment->baseSeq = baseSeq;
+    segment->logPath = directory + "/" + name + ".log";
+    segment->indexPath = directory + "/" + name + ".idx";
+    segment->capacity = limits.segmentBytes;
+    segment->indexCapacity = limits.segmentBytes / INDEX_INTERVAL + 1;
+
+    if (!create) {
+        // Segmento de uma execução anterior: mapeia com o tamanho que ele já tem, se maior
+        std::error_code error;
+        uintmax_t existing = std::filesystem::file_size(segment->logPath, error);
+        if (!error) {
+            segment->capacity = std::max<size_t>(segment->capacity, existing);
+            segment->indexCapacity = segment->capacity / INDEX_INTERVAL + 1;
+        }
+    }
+
+    segment->log = static_cast<char*>(mapFile(segment->logPath, segment->capacity));
+    segment->index = static_cast<IndexEntry*>(mapFile(segment->indexPath, segment->indexCapacity * sizeof(IndexEntry)));
+    if (!segment->log || !segment->index) {
+        std::cerr << "Could not map history segment " << segment->logPath << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    if (!create) {
+        // O índice é reconstruído varrendo os registros; o primeiro de tamanho 0 é o fim
+        size_t offset = 0;
+        while (offset + sizeof(RecordHeader) <= segment->capacity) {
+            RecordHeader header;
+            memcpy(&header, segment->log + offset, sizeof(header));
+            if (header.length == 0 || offset + recordSize(header.length) > segment->capacity) {
+                break;
+            }
+            segment->addRecord(header, offset);
+            offset = segment->size;
+        }
+    }
+    return segment;
+}
+
+void MessageLog::roll(uint64_t baseSeq) {
+    std::shared_ptr<Segment> segment = openSegment(baseSeq, true);
+    if (!segment) {
+        persistent = false;
+        return;
+    }
+    segments[baseSeq] = segment;
+}
+
+void MessageLog::dropOldest() {
+    auto oldest = segments.begin();
+    totalBytes -= oldest->second->size;
+    // Quem está lendo ainda segura o mapeamento; os arquivos já podem sair do diretório
+    unlink(oldest->second->logPath.c_str());
+    unlink(oldest->second->indexPath.c_str());
+    segments.erase(oldest);
+}
+
+std::shared_ptr<const std::string> MessageLog::append(uint64_t epoch, int64_t nowMs, std::string head,
+                                                      const std::string& tail) {
+    const size_t SEQ_DIGITS = 20;  // Maior uint64_t em decimal
+    head.reserve(head.size() + SEQ_DIGITS + tail.size());
+    auto frame = std::make_shared<std::string>(std::move(head));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t seq = nextSeq++;
+    char digits[SEQ_DIGITS + 1];
+    frame->append(digits, snprintf(digits, sizeof(digits), "%llu", (unsigned long long)seq));
+    frame->append(tail);
+    if (!persistent) {
+        return frame;
+    }
+
+    RecordHeader header{(uint32_t)(frame->size() + 1), 0, seq, epoch, nowMs};
+    size_t size = recordSize(header.length);
+    if (size > limits.segmentBytes) {
+        // Não cabe nem em um segmento vazio: a sequência fica sem registro
+        return frame;
+    }
+
+    Segment* active = segments.rbegin()->second.get();
+    if (active->size + size > active->capacity) {
+        roll(seq);
+        if (!persistent) {
+            return frame;
+        }
+        active = segments.rbegin()->second.get();
+        retain(nowMs);
+    }
+
+    size_t offset = active->size;
+    char* record = active->log + offset;
+    memcpy(record + sizeof(header), frame->data(), frame->size());
+    record[sizeof(header) + frame->size()] = '\n';
+    // O cabeçalho vai por último: um registro com tamanho != 0 está sempre completo
+    memcpy(record, &header, sizeof(header));
+    active->addRecord(header, offset);
+    totalBytes += size;
+    return frame;
+}
+
+size_t MessageLog::read(uint64_t fromSeq, size_t maxFrames, size_t maxBytes, std::string& out, uint64_t& next) const {
+    struct View {
+        std::shared_ptr<Segment> segment;
+        size_t size;
+        size_t indexCount;
+    };
+    std::vector<View> views;
+    {
+        // Só o que já estava publicado entra; a leitura em si roda sem o mutex
+        std::lock_guard<std::mutex> lock(mutex);
+        next = std::min(std::max(fromSeq, segments.empty() ? nextSeq : segments.begin()->first), nextSeq);
+        auto it = segments.upper_bound(fromSeq);
+        if (it != segments.begin()) {
+            --it;
+        }
+        for (; it != segments.end(); ++it) {
+            views.push_back({it->second, it->second->size, it->second->indexCount});
+        }
+    }
+
+    size_t copied = 0;
+    size_t bytes = 0;
+    for (const View& view : views) {
+        const Segment& segment = *view.segment;
+
+        // Última entrada do índice com seq <= fromSeq
+        const IndexEntry* begin = segment.index;
+        const IndexEntry* end = segment.index + view.indexCount;
+        const IndexEntry* entry = std::upper_bound(begin, end, fromSeq,
+            [](uint64_t seq, const IndexEntry& e) { return seq < e.seq; });
+        size_t offset = entry == begin ? 0 : (entry - 1)->offset;
+
+        while (offset < view.size) {
+            RecordHeader header;
+            memcpy(&header, segment.log + offset, sizeof(header));
+            if (header.seq >= fromSeq) {
+                if (copied == maxFrames || (copied > 0 && bytes + header.length > maxBytes)) {
+                    return copied;
+                }
+                out.append(segment.log + offset + sizeof(header), header.length);
+                bytes += header.length;
+                copied++;
+                next = header.seq + 1;
+            }
+            offset += recordSize(header.length);
+        }
+    }
+    return copied;
+}
+
+void MessageLog::enforceRetention(int64_t nowMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retain(nowMs);
+}
+
+void MessageLog::retain(int64_t nowMs) {
+    while (segments.size() > 1) {
+        const Segment& oldest = *segments.begin()->second;
+        bool tooBig = limits.maxBytes > 0 && totalBytes > limits.maxBytes;
+        bool tooOld = limits.maxAgeMs > 0 && nowMs - oldest.lastAppendMs > limits.maxAgeMs;
+        if (!tooBig && !tooOld) {
+            break;
+        }
+        dropOldest();
+    }
+}
+
+uint64_t MessageLog::firstSeq() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.empty() ? nextSeq : segments.begin()->first;
+}
+
+uint64_t MessageLog::lastSeq() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextSeq - 1;
+}
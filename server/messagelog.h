@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Log append-only das mensagens de uma sala, em segmentos mapeados com mmap.
+ *
+ * Cada registro guarda o frame exatamente como foi enviado aos membros (ciphertext
+ * opaco, o servidor nunca vê chaves) com a sequência e a época. Cada segmento tem um
+ * índice esparso, também mapeado, com uma entrada a cada INDEX_INTERVAL bytes de log,
+ * então achar uma sequência é uma busca binária no índice e uma varredura curta.
+ *
+ * A retenção apaga os segmentos mais antigos por tamanho total ou idade; o segmento
+ * ativo nunca é apagado e o nome dele guarda a próxima sequência entre reinícios.
+ * Sem diretório (ou se ele não puder ser usado) o log só numera as mensagens.
+ */
+class MessageLog {
+public:
+    struct Limits {
+        size_t segmentBytes;  // Capacidade de cada segmento
+        size_t maxBytes;      // Soma dos segmentos a partir da qual os mais antigos saem (0 = sem limite)
+        int64_t maxAgeMs;     // Idade da última mensagem de um segmento para ele sair (0 = sem limite)
+    };
+
+    MessageLog(const std::string& directory, const Limits& limits);
+    ~MessageLog();
+
+    MessageLog(const MessageLog&) = delete;
+    MessageLog& operator=(const MessageLog&) = delete;
+
+    // Atribui a próxima sequência e grava o frame head + sequência em decimal + tail (sem o
+    // '\n' final). As duas partes vêm prontas: sob o mutex só a sequência é formatada.
+    std::shared_ptr<const std::string> append(uint64_t epoch, int64_t nowMs, std::string head, const std::string& tail);
+
+    // Acrescenta a 'out' os frames a partir de fromSeq, um por linha, até maxFrames ou
+    // maxBytes. Retorna quantos foram copiados; nextSeq recebe a sequência seguinte.
+    size_t read(uint64_t fromSeq, size_t maxFrames, size_t maxBytes, std::string& out, uint64_t& nextSeq) const;
+
+    void enforceRetention(int64_t nowMs);
+
+    uint64_t firstSeq() const;
+    uint64_t lastSeq() const;
+
+private:
+    struct Segment;
+
+    std::string directory;
+    Limits limits;
+    bool persistent = false;
+
+    mutable std::mutex mutex;
+    std::map<uint64_t, std::shared_ptr<Segment>> segments;  // Pela primeira sequência
+    uint64_t nextSeq = 1;
+    size_t totalBytes = 0;
+
+    std::shared_ptr<Segment> openSegment(uint64_t baseSeq, bool create);
+    void roll(uint64_t baseSeq);
+    void dropOldest();
+    void retain(int64_t nowMs);  // Chamada com o mutex travado
+};
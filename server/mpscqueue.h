@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @brief Fila lock-free com vários produtores e um único consumidor (algoritmo de D. Vyukov).
+ *
+ * push() é wait-free (um exchange atômico) e pode ser chamado de qualquer thread.
+ * pop() e empty() só podem ser chamados pela thread consumidora. Logo depois de um
+ * push concorrente a fila pode parecer vazia por um instante; quem consome deve
+ * tentar de novo em vez de assumir que não há mais itens.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    ~MpscQueue() {
+        T discarded;
+        while (pop(discarded)) {
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value = std::move(value);
+        pushNode(node);
+    }
+
+    bool pop(T& out) {
+        Node* first = tail;
+        Node* next = first->next.load(std::memory_order_acquire);
+
+        if (first == &stub) {
+            if (next == nullptr) {
+                return false;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next == nullptr) {
+            // Último nó: só pode ser retirado depois de recolocar o stub atrás dele
+            if (first != head.load(std::memory_order_acquire)) {
+                return false; // Um produtor está no meio de um push
+            }
+            stub.next.store(nullptr, std::memory_order_relaxed);
+            pushNode(&stub);
+            next = first->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+        }
+
+        tail = next;
+        out = std::move(first->value);
+        delete first;
+        return true;
+    }
+
+    bool empty() const {
+        return tail == &stub
+            && stub.next.load(std::memory_order_acquire) == nullptr
+            && head.load(std::memory_order_acquire) == &stub;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    void pushNode(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    alignas(64) std::atomic<Node*> head;  // Lado dos produtores
+    alignas(64) Node* tail;               // Lado do consumidor
+    Node stub;
+};
@@ -0,0 +1,46 @@
+#include "rcu.h"
+
+#include <algorithm>
+
+// Todas as operações usam seq_cst: o store da época pelo leitor e o load do ponteiro
+// publicado precisam de ordem total com o exchange e a varredura feitos pelo escritor.
+
+EpochDomain::Guard::Guard(EpochDomain& domain, int reader) : slot(domain.readers[reader].epoch) {
+    slot.store(domain.globalEpoch.load());
+}
+
+EpochDomain::Guard::~Guard() {
+    slot.store(0);
+}
+
+EpochDomain::EpochDomain(int maxReaders)
+    : readers(new ReaderSlot[maxReaders]), maxReaders(maxReaders) {}
+
+void EpochDomain::retire(std::function<void()> release) {
+    // Quem entrar depois deste incremento já enxerga a versão nova
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    retired.emplace_back(epoch, std::move(release));
+}
+
+void EpochDomain::reclaim() {
+    if (retired.empty()) {
+        return;
+    }
+
+    // Menor época anunciada por um leitor ativo
+    uint64_t oldest = globalEpoch.load();
+    for (int i = 0; i < maxReaders; ++i) {
+        uint64_t epoch = readers[i].epoch.load();
+        if (epoch != 0) {
+            oldest = std::min(oldest, epoch);
+        }
+    }
+
+    // Aposentado na época E pode ter sido visto por leitores que entraram até E
+    auto firstKept = std::stable_partition(retired.begin(), retired.end(),
+        [oldest](const std::pair<uint64_t, std::function<void()>>& entry) { return entry.first < oldest; });
+    for (auto it = retired.begin(); it != firstKept; ++it) {
+        it->second();
+    }
+    retired.erase(retired.begin(), firstKept);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Reclamação por épocas (EBR) para dados publicados no estilo RCU.
+ *
+ * Cada thread leitora tem um slot fixo onde anuncia a época em que entrou na seção
+ * de leitura. Quem publica uma versão nova aposenta a antiga na época corrente e
+ * avança a época global; a versão aposentada só é liberada quando nenhum leitor
+ * anunciado pode tê-la visto. Ler custa dois stores no próprio slot, sem locks.
+ *
+ * Há um único escritor: retire() e reclaim() só podem ser chamados por ele.
+ */
+class EpochDomain {
+public:
+    // Seção de leitura: enquanto existir, o que foi lido não é liberado
+    class Guard {
+    public:
+        Guard(EpochDomain& domain, int reader);
+        ~Guard();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        std::atomic<uint64_t>& slot;
+    };
+
+    explicit EpochDomain(int maxReaders);
+
+    Guard pin(int reader) { return Guard(*this, reader); }
+
+    // Agenda a liberação de algo que acabou de deixar de ser publicado
+    void retire(std::function<void()> release);
+    // Libera o que nenhum leitor pode mais estar vendo
+    void reclaim();
+
+    size_t pending() const { return retired.size(); }
+
+private:
+    // Uma linha de cache por leitor: os leitores nunca escrevem na linha de outro
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};  // 0 = fora de seção de leitura
+    };
+
+    std::unique_ptr<ReaderSlot[]> readers;
+    int maxReaders;
+    alignas(64) std::atomic<uint64_t> globalEpoch{1};
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired;
+};
+
+/**
+ * @brief Ponteiro para um objeto imutável trocado inteiro a cada publicação.
+ *
+ * Leitores chamam read() dentro de um EpochDomain::Guard e podem usar o objeto até
+ * o fim da seção; o escritor chama publish() e a versão antiga é liberada pelo domínio.
+ */
+template <typename T>
+class RcuPtr {
+public:
+    explicit RcuPtr(EpochDomain& domain, std::unique_ptr<const T> initial = std::make_unique<const T>())
+        : domain(domain), current(initial.release()) {}
+
+    ~RcuPtr() {
+        delete current.load();
+    }
+
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    const T* read() const {
+        return current.load();
+    }
+
+    void publish(std::unique_ptr<const T> next) {
+        const T* previous = current.exchange(next.release());
+        domain.retire([previous] { delete previous; });
+        domain.reclaim();
+    }
+
+private:
+    EpochDomain& domain;
+    std::atomic<const T*> current;
+};
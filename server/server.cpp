@@ -3,26 +3,297 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
 #include <cstring>
-#include <map>
+#include <cerrno>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <nlohmann/json.hpp>
 #include "server.h"
+#include "timerwheel.h"
+#include "latencyhistogram.h"
+#include "actor.h"
+#include "mpscqueue.h"
+#include "memberregistry.h"
+#include "rcu.h"
+#include "fanoutpool.h"
+#include "tokenbucket.h"
+#include "messagelog.h"
+#include "bdcheck.h"
 
 using namespace std;
 using namespace nlohmann;
 
 const int MAX_CLIENTS = 30;
 
-using ull = unsigned long long int; 
+const chrono::milliseconds ROUND_TIMEOUT(5000);          // Prazo de cada rodada da troca de chaves
+const chrono::milliseconds AUTH_TIMEOUT(10000);          // Prazo para enviar C2S_AUTHENTICATE_AND_JOIN
+const chrono::milliseconds IDLE_TIMEOUT(15 * 60 * 1000); // Conexão sem nenhuma mensagem
+const int KEY_CONFIRMATION_RETRIES = 2;                    // Trocas repetidas na hora quando as chaves divergem
+const chrono::milliseconds REKEY_DEBOUNCE(100);          // Junta entradas/saídas próximas em uma troca
+const chrono::milliseconds STATS_INTERVAL(60000);        // Intervalo entre resumos de latência no log
+const int POLL_TIMEOUT_MS = 100;                         // Para as threads de conexão verem isRunning
+const size_t MEMBERSHIP_LOG_SIZE = 256;                  // Deltas guardados para reenviar a quem perdeu versões
+const size_t CACHE_LINE_SIZE = 64;
+const size_t OUTBUF_HIGH_WATER = 256 * 1024;             // Bytes em outBuf a partir dos quais as filas esperam
+const size_t INBUF_LIMIT = 1024 * 1024;                  // Bytes lidos e ainda não processados por conexão
+const double RATE_BURST_SECONDS = 2.0;                   // Rajada aceita pelos token buckets, em segundos de taxa
+const chrono::milliseconds SLOW_DOWN_NOTICE_INTERVAL(1000); // Intervalo mínimo entre avisos de rate para o mesmo cliente
+const chrono::milliseconds OVERLOAD_CHECK_INTERVAL(500); // Período da checagem de sobrecarga global
+const chrono::milliseconds OVERLOAD_LAG(200);            // Atraso do ator que indica CPU saturada
+const size_t PARTITIONS_PER_FANOUT_THREAD = 4;           // Sobra partições para roubar quando o custo varia
+const char* const DEFAULT_ROOM = "general";              // Sala em que todo cliente entra ao autenticar
+const size_t ROOM_NAME_LIMIT = 64;                       // Tamanho máximo do nome de uma sala
+const size_t STREAMS_PER_CONNECTION = 16;                // Salas simultâneas em uma mesma conexão
+const size_t HISTORY_FETCH_FRAMES = 200;                 // Mensagens por resposta de C2S_FETCH_HISTORY
+const size_t HISTORY_FETCH_BYTES = 512 * 1024;           // Bytes por resposta de C2S_FETCH_HISTORY
+const chrono::milliseconds HISTORY_RETENTION_INTERVAL(60000); // Período da retenção por idade do histórico
+const size_t RESUME_REPLAY_FRAMES = 1000;                // Mensagens perdidas reenviadas por sala ao retomar
 
+using ull = unsigned long long int;
+using StreamId = uint32_t;  // Identifica a sala nos frames; atribuído na criação e nunca reusado
+
+// Grupos do Burmester-Desmedt que os clientes podem escolher. O servidor repassa os valores
+// e só faz contas com eles para conferir a rodada 1 (bdcheck.h).
+static bool isKnownKeyGroup(const string& name) {
+    return name == "modp" || name == "ed25519";
+}
+
+// Base64 padrão com '='; só os pontos e escalares da curva chegam assim
+static bool decodeBase64(const string& text, string& out) {
+    if (text.size() % 4 != 0) {
+        return false;
+    }
+    out.clear();
+    uint32_t buffer = 0;
+    int bits = 0;
+    size_t padding = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char ch = text[i];
+        int value;
+        if (ch >= 'A' && ch <= 'Z') value = ch - 'A';
+        else if (ch >= 'a' && ch <= 'z') value = ch - 'a' + 26;
+        else if (ch >= '0' && ch <= '9') value = ch - '0' + 52;
+        else if (ch == '+') value = 62;
+        else if (ch == '/') value = 63;
+        else if (ch == '=' && i + 2 >= text.size()) { ++padding; continue; }
+        else return false;
+        if (padding > 0) {
+            return false;
+        }
+        buffer = (buffer << 6) | (uint32_t)value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((buffer >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+// Elementos e provas da rodada 1 como chegam no JSON: número no MODP, base64 na curva
+static bool parseElement(const json& value, BdCheck::ModpGroup::Element& out) {
+    if (!value.is_number_unsigned()) {
+        return false;
+    }
+    out = value.get<uint64_t>();
+    return BdCheck::ModpGroup::valid(out);
+}
+
+static bool parseElement(const json& value, BdCheck::EdGroup::Element& out) {
+    string bytes;
+    return value.is_string() && decodeBase64(value.get<string>(), bytes) && bytes.size() == Ed25519::POINT_BYTES &&
+           Ed25519::decode((const uint8_t*)bytes.data(), out);
+}
+
+static bool parseProof(const json& value, BdCheck::ModpGroup::Proof& out) {
+    if (!value.is_object() || !value.contains("c") || !value.contains("s") ||
+        !value["c"].is_number_unsigned() || !value["s"].is_number_unsigned()) {
+        return false;
+    }
+    out.c = value["c"].get<uint64_t>();
+    out.s = value["s"].get<uint64_t>();
+    return true;
+}
+
+static bool parseProof(const json& value, BdCheck::EdGroup::Proof& out) {
+    if (!value.is_object() || !value.contains("c") || !value.contains("s") ||
+        !value["c"].is_string() || !value["s"].is_string()) {
+        return false;
+    }
+    string c, s;
+    if (!decodeBase64(value["c"].get<string>(), c) || c.size() != sizeof(out.c) ||
+        !decodeBase64(value["s"].get<string>(), s) || s.size() != sizeof(out.s)) {
+        return false;
+    }
+    memcpy(out.c, c.data(), sizeof(out.c));
+    memcpy(out.s, s.data(), sizeof(out.s));
+    return true;
+}
+
+// Dados frios de um membro: só as rodadas da troca de chaves e os logs os leem
 struct User {
-    string username;   
-    ull publicKey;
-    bool hasCalculatedIntermediate;  // Flag para controlar se já calculou valor intermediário
-    ull intermediateValue;           // Valor intermediário calculado
+    string username;
+    json publicKey;                          // Opaca: número (modp) ou ponto em base64 (ed25519)
+    bool hasCalculatedIntermediate = false;  // Flag para controlar se já calculou valor intermediário
+    json intermediateValue;                  // Valor intermediário calculado
+    json intermediateProof;                  // Prova de que X_i usa a chave privada de roundPublicKey
+    json roundPublicKey;                     // Chave pública deste membro na troca em andamento
+    bool hasCompletedRound2 = false;         // Flag para controlar se confirmou a rodada 2
+    json keyConfirmation;                    // Compromisso com a chave derivada na rodada 2 (null = não mandou)
+    json nextPublicKey;                      // Par anunciado para a próxima troca completa (null = o de entrada)
+    MemberId memberId = NO_MEMBER;           // Entrada no registro de membros
+    unsigned streamTicket = 0;               // Entrada da conexão que pôs o membro na sala
+};
+
+// Entrada do log de membros: cada entrada/saída incrementa a versão da lista
+struct MembershipChange {
+    ull version;
+    bool added;
+    string username;
+    json publicKey;
+};
+
+// Classes das filas de saída, da mais para a menos prioritária. Os deltas e snapshots da
+// lista de membros vão em Control: as rodadas da troca de chaves dependem deles chegarem antes.
+enum class EgressClass : int {
+    Control,     // Troca de chaves, lista de membros, PING
+    Membership,  // S2C_USER_NOTIFICATION (entradas, saídas, expulsões)
+    Chat,        // S2C_BROADCAST_GROUP_MESSAGE
+    Bulk         // Transferências grandes sem pressa
+};
+const int EGRESS_CLASSES = 4;
+// Frames retirados de cada classe por rodada do drainEgress
+const int EGRESS_WEIGHTS[EGRESS_CLASSES] = {8, 4, 2, 1};
+// Frames pendentes no slot a partir dos quais a classe é descartada (Control nunca)
+const size_t EGRESS_SHED_BACKLOG[EGRESS_CLASSES] = {SIZE_MAX, 1024, 4096, 256};
+
+// Mensagem pronta para envio. O mesmo buffer é compartilhado por todos os destinatários
+// de um broadcast; a geração descarta o que era para a conexão anterior do slot.
+// Sem 'data' é um aviso do executor de que tirou a conexão da sala 'stream'.
+struct EgressFrame {
+    unsigned generation = 0;
+    shared_ptr<const string> data;
+    StreamId stream = 0;
+    unsigned ticket = 0;
+};
+
+// Estado quente de um slot, compartilhado entre threads. A primeira linha de cache
+// guarda o fd, a geração e as flags; as filas de saída vêm logo depois, cada uma com o
+// lado dos produtores e o do consumidor em linhas próprias. Nomes e chaves ficam em User.
+struct alignas(CACHE_LINE_SIZE) Session {
+    atomic<int> socket{-1};             // -1 = slot livre
+    atomic<unsigned> generation{0};     // Muda a cada conexão aceita no slot
+    atomic<unsigned> authGeneration{0}; // Conexão do slot que já se autenticou (0 = nenhuma)
+    atomic<int> missedHeartbeats{0};    // PINGs enviados desde o último recebimento
+    atomic<bool> wakePending{false};    // Evita um write() no eventfd por mensagem
+    int wakeFd = -1;                    // eventfd que acorda o poll() da thread da conexão
+    atomic<long long> lastActivity{0};  // Último recebimento (ms, relógio monotônico)
+    atomic<size_t> backlog{0};          // Frames nas filas, somando todas as classes
+    atomic<bool> resumable{true};       // Ao cair, a sessão espera C2S_RESUME em vez de sair das salas
+    atomic<bool> parked{false};         // Slot reservado para uma sessão esperando C2S_RESUME
+    // Os produtores enfileiram, a thread da conexão consome e escreve no socket
+    MpscQueue<EgressFrame> egress[EGRESS_CLASSES];
+};
+
+// Destinatários de um broadcast: publicado pelo executor da sala a cada entrada/saída e lido
+// sem locks pelas threads de conexão, que distribuem as mensagens do chat sozinhas
+struct RecipientList {
+    struct Recipient {
+        int slot;
+        unsigned generation;
+    };
+    vector<Recipient> recipients;
+
+    bool contains(int slot, unsigned generation) const {
+        for (const Recipient& r : recipients) {
+            if (r.slot == slot) {
+                return r.generation == generation;
+            }
+        }
+        return false;
+    }
+};
+
+// Sala de chat: membros, troca de chaves e log de membros próprios. Tudo que não é
+// atômico só é lido ou alterado por tarefas do executor da sala; várias salas dividem
+// o mesmo executor, mas uma sala nunca muda de executor.
+struct Room {
+    StreamId id;
+    string name;
+    Actor& executor;
+
+    // Snapshot imutável dos destinatários; cada thread de conexão lê no próprio slot do domínio
+    EpochDomain fanoutEpochs;
+    RcuPtr<RecipientList> recipients;
+    // Limites da sala: mensagens de chat e bytes multiplicados pelo fan-out
+    TokenBucket messageBucket;
+    TokenBucket byteBucket;
+    // Numera as mensagens de chat e guarda os frames já cifrados; tem lock próprio
+    unique_ptr<MessageLog> history;
+
+    // O fan-out só lê joinedGeneration (contíguo, poucas linhas de cache) e a fila do slot
+    vector<unsigned> joinedGeneration;  // Conexão do slot que entrou na sala (0 = nenhuma)
+    vector<User> users;
+    MemberRegistry members;
+    string keyGroup;                     // Definido por quem entra na sala vazia; os demais precisam usar o mesmo
+    bool keyExchangeInProgress = false;  // Flag para controlar se troca de chaves está em andamento
+    int round1Completed = 0;             // Contador de usuários que completaram rodada 1
+    int round2Completed = 0;             // Contador de usuários que completaram rodada 2
+    ull pendingEpoch = 0;                // Época da troca de chaves em andamento
+    ull currentEpoch = 0;                // Última época que todos os membros têm (0 = chave inicial, pública)
+    // Entrada rápida em andamento (keyExchangeInProgress também fica ligado)
+    MemberId fastJoiner = NO_MEMBER;
+    MemberId fastJoinDistributor = NO_MEMBER;
+    json fastJoinConfirmation;           // Compromisso do distribuidor com a chave entregue
+    int fastJoins = 0;                   // Entradas rápidas desde a última troca completa
+    int confirmationRetries = 0;         // Trocas repetidas seguidas por chaves divergentes
+    ull membershipVersion = 0;           // Versão atual da lista de membros
+    deque<MembershipChange> membershipLog;
+    TimerWheel::TimerId roundTimer = 0;
+    TimerWheel::TimerId rekeyTimer = 0;
+
+    Room(StreamId id, const string& name, Actor& executor)
+        : id(id), name(name), executor(executor), fanoutEpochs(MAX_CLIENTS), recipients(fanoutEpochs),
+          joinedGeneration(MAX_CLIENTS, 0), users(MAX_CLIENTS) {}
+};
+
+// Estado local da thread que atende uma conexão
+struct ConnectionState {
+    int threadId;
+    int socket;
+    unsigned generation;
+    bool joined = false;
+    string username;
+    json publicKey;
+    string keyGroup;  // Grupo do Burmester-Desmedt escolhido pelo cliente na autenticação
+    string resumeToken;
+    // Salas em que a conexão está, pelo stream de cada uma; só esta thread lê ou altera.
+    // O ticket identifica cada entrada: o executor o devolve quando tira a conexão da sala.
+    struct JoinedStream {
+        Room* room;
+        unsigned ticket;
+    };
+    unordered_map<StreamId, JoinedStream> streams;
+    unsigned lastTicket = 0;
+    string inBuf;
+    string outBuf;
+    // Limites por conexão; só a thread da conexão os usa
+    TokenBucket messageBucket;
+    TokenBucket byteBucket;
+    long long throttledUntilUs = 0;  // Leitura do socket suspensa até este instante
+    long long lastSlowDownUs = 0;    // Último S2C_SLOW_DOWN por rate enviado
 };
 
 
@@ -32,14 +303,59 @@ class Server {
     int serverSocket;
     sockaddr_in serverAddress;
     vector<thread> workerThreads;
-    vector<atomic<int>> clientSockets;
-    vector<string> clientNames;
-    vector<User> users;
     atomic<bool> isRunning;
-    vector<GrupMember> groupMembers;
-    bool keyExchangeInProgress;      // Flag para controlar se troca de chaves está em andamento
-    int round1Completed;             // Contador de usuários que completaram rodada 1
-    int round2Completed;             // Contador de usuários que completaram rodada 2
+    ServerConfig config;
+
+    // Estado quente por slot compartilhado entre threads, um Session alinhado por slot
+    unique_ptr<Session[]> sessions;
+    LatencyHistogram heartbeatRtt;
+    atomic<uint64_t> shedFrames{0};  // Frames descartados por clientes atrasados (desde o último resumo)
+
+    // Divide broadcasts de salas com pelo menos config.fanoutThreshold destinatários
+    unique_ptr<FanoutPool> fanoutPool;
+
+    // Ligado pela checagem periódica; mensagens de chat são recusadas com S2C_SLOW_DOWN
+    atomic<bool> overloaded{false};
+
+    // Prazos das rodadas, timeouts de conexão e debounce de rekey
+    TimerWheel timers;
+    thread timerThread;
+
+    // Executores das salas: cada sala é criada presa a um deles, em rodízio. As threads de
+    // conexão e os timers apenas postam comandos para o executor da sala.
+    vector<unique_ptr<Actor>> executors;
+    // Sonda de atraso de cada executor para a checagem de sobrecarga
+    struct ExecutorProbe {
+        atomic<long long> postedAt{0};  // Sonda ainda na fila (0 = nenhuma)
+        atomic<long long> lag{0};       // Atraso medido pela última sonda
+    };
+    unique_ptr<ExecutorProbe[]> executorProbes;
+
+    // Salas nunca são destruídas, então um Room* continua válido depois de solto o mutex
+    mutex roomsMutex;
+    unordered_map<string, unique_ptr<Room>> rooms;
+    StreamId lastStream = 0;
+    Room* defaultRoom = nullptr;  // Frames sem "stream" valem para ela
+
+    // Nomes dos clientes autenticados: únicos no servidor, não só na sala
+    mutex namesMutex;
+    unordered_set<string> namesInUse;
+
+    // Conexão que caiu sem C2S_LOGOUT: continua nas salas, com o mesmo slot, até o prazo
+    // de retomada. Nenhuma sala vê saída nem faz troca de chaves nesse meio tempo.
+    struct ParkedSession {
+        int slot;
+        unsigned generation;
+        string username;
+        json publicKey;
+        string keyGroup;
+        vector<Room*> rooms;
+        TimerWheel::TimerId expiry = 0;
+    };
+    mutex parkedMutex;
+    unordered_map<string, ParkedSession> parkedSessions;  // Pelo token de retomada
+
+    atomic<ull> epochCounter{0};  // Última época de chave emitida, única entre salas
 
     // send all bytes in 'data' reliably
     // returns true on success, false on error
@@ -48,517 +364,1733 @@ class Server {
         size_t totalSent = 0;
 
         while (totalSent < len) {
-            ssize_t sent = send(sockfd, buf + totalSent, len - totalSent, 0);
+            ssize_t sent = send(sockfd, buf + totalSent, len - totalSent, MSG_NOSIGNAL);
             if (sent <= 0) {
                 return false; // error or connection closed
             }
-            totalSent += sent;
+            totalSent += sent;
+        }
+
+        // send the delimiter '\n'
+        char delimiter = '\n';
+        if (send(sockfd, &delimiter, 1, MSG_NOSIGNAL) != 1) {
+            return false;
+        }
+
+        return true;
+    }
+
+    // ========================================================================
+    // Threads de conexão: leem frames, postam comandos e escrevem a fila de saída
+    // ========================================================================
+
+    void handleClient(int threadId) {
+        while (isRunning) {
+            int clientSocket = sessions[threadId].socket.load();
+            if (clientSocket != -1) {
+                serveConnection(threadId, clientSocket);
+            } else {
+                // If no client, sleep briefly to avoid busy-waiting
+                this_thread::sleep_for(chrono::milliseconds(100));
+            }
+        }
+    }
+
+    void serveConnection(int threadId, int clientSocket) {
+        Session& conn = sessions[threadId];
+        ConnectionState state;
+        state.threadId = threadId;
+        state.socket = clientSocket;
+        state.generation = sessions[threadId].generation;
+        state.messageBucket.configure(config.clientMessageRate, config.clientMessageRate * RATE_BURST_SECONDS);
+        state.byteBucket.configure(config.clientByteRate, config.clientByteRate * RATE_BURST_SECONDS);
+
+        fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL, 0) | O_NONBLOCK);
+
+        bool open = true;
+        while (isRunning && open) {
+            // Backpressure: enquanto a conexão estiver acima do limite o socket não é lido,
+            // a janela TCP enche e o próprio cliente passa a esperar no send()
+            int timeout = POLL_TIMEOUT_MS;
+            if (state.throttledUntilUs != 0) {
+                long long remaining = state.throttledUntilUs - nowUs();
+                if (remaining <= 0) {
+                    state.throttledUntilUs = 0;
+                    processFrames(state);
+                } else {
+                    timeout = min<long long>(timeout, (remaining + 999) / 1000);
+                }
+            }
+            bool reading = state.throttledUntilUs == 0 && state.inBuf.size() < INBUF_LIMIT;
+
+            pollfd fds[2];
+            fds[0] = {clientSocket, (short)((reading ? POLLIN : 0) | (state.outBuf.empty() ? 0 : POLLOUT)), 0};
+            fds[1] = {conn.wakeFd, POLLIN, 0};
+
+            if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+                break;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                uint64_t signals;
+                ssize_t ignored = read(conn.wakeFd, &signals, sizeof(signals));
+                (void)ignored;
+            }
+            drainEgress(state);
+
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR) && reading) {
+                open = readFrames(state);
+            }
+            if (open && !state.outBuf.empty()) {
+                open = flushOutput(state);
+            }
+        }
+
+        // Última tentativa de entregar o que ficou na fila (ex.: aviso de expulsão)
+        drainEgress(state);
+        flushOutput(state);
+
+        if (state.joined && conn.resumable && config.resumeGrace.count() > 0 && isRunning) {
+            parkSession(state);
+        } else if (state.joined) {
+            while (!state.streams.empty()) {
+                leaveRoom(state, *state.streams.begin()->second.room, "USER_DISCONNECTED");
+            }
+            lock_guard<mutex> lock(namesMutex);
+            namesInUse.erase(state.username);
+        } else {
+            cout << "Client disconnected before sending name on thread " << threadId << endl;
+        }
+
+        close(clientSocket);
+        discardEgress(threadId);
+        sessions[threadId].authGeneration = 0;
+        sessions[threadId].socket = -1;
+    }
+
+    // Passa frames das filas para outBuf por prioridade ponderada. Com outBuf cheio o resto
+    // fica nas filas, então um frame de controle que chega depois ainda fura a fila do chat.
+    void drainEgress(ConnectionState& state) {
+        Session& conn = sessions[state.threadId];
+        conn.wakePending = false;
+
+        EgressFrame frame;
+        bool progress = true;
+        while (progress && state.outBuf.size() < OUTBUF_HIGH_WATER) {
+            progress = false;
+            for (int cls = 0; cls < EGRESS_CLASSES; ++cls) {
+                for (int n = 0; n < EGRESS_WEIGHTS[cls] && conn.egress[cls].pop(frame); ++n) {
+                    conn.backlog--;
+                    progress = true;
+                    // Mensagem destinada à conexão anterior deste slot
+                    if (frame.generation != state.generation) {
+                        continue;
+                    }
+                    if (!frame.data) {
+                        // Só apaga a entrada que o executor tirou, não uma feita depois
+                        auto joined = state.streams.find(frame.stream);
+                        if (joined != state.streams.end() && joined->second.ticket == frame.ticket) {
+                            state.streams.erase(joined);
+                        }
+                        continue;
+                    }
+                    state.outBuf.append(*frame.data);
+                    state.outBuf.push_back('\n');
+                }
+            }
+        }
+    }
+
+    // Descarta o que sobrou para a conexão que acabou de fechar
+    void discardEgress(int threadId) {
+        Session& conn = sessions[threadId];
+        EgressFrame frame;
+        for (int cls = 0; cls < EGRESS_CLASSES; ++cls) {
+            while (conn.egress[cls].pop(frame)) {
+                conn.backlog--;
+            }
+        }
+    }
+
+    // Envia o que o kernel aceitar sem bloquear; o resto espera o próximo POLLOUT
+    bool flushOutput(ConnectionState& state) {
+        size_t totalSent = 0;
+        while (totalSent < state.outBuf.size()) {
+            ssize_t sent = send(state.socket, state.outBuf.data() + totalSent,
+                                state.outBuf.size() - totalSent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                break;
+            }
+            totalSent += sent;
+        }
+        state.outBuf.erase(0, totalSent);
+        return true;
+    }
+
+    // Lê tudo que estiver disponível e processa cada mensagem terminada em '\n'
+    // Returns false on error/connection closed
+    bool readFrames(ConnectionState& state) {
+        char temp[4096];
+        bool open = true;
+
+        while (state.inBuf.size() < INBUF_LIMIT) {
+            ssize_t bytesReceived = recv(state.socket, temp, sizeof(temp), MSG_DONTWAIT);
+            if (bytesReceived > 0) {
+                state.inBuf.append(temp, bytesReceived);
+                continue;
+            }
+            if (bytesReceived < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesReceived == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                open = false; // error or connection closed
+            }
+            break;
+        }
+
+        processFrames(state);
+
+        // Buffer cheio sem nenhum frame completo: a linha não cabe no limite
+        if (open && state.throttledUntilUs == 0 && state.inBuf.size() >= INBUF_LIMIT) {
+            cout << "Frame larger than " << INBUF_LIMIT << " bytes on thread " << state.threadId << ", closing" << endl;
+            open = false;
+        }
+        return open;
+    }
+
+    // Trata os frames completos de inBuf. Um frame barrado pelos limites fica no buffer
+    // e é tentado de novo quando a suspensão da leitura acabar.
+    void processFrames(ConnectionState& state) {
+        size_t start = 0;
+        size_t pos;
+        while (state.throttledUntilUs == 0 && (pos = state.inBuf.find('\n', start)) != string::npos) {
+            touch(state.threadId);
+            if (!handleFrame(state, state.inBuf.substr(start, pos - start))) {
+                break;
+            }
+            start = pos + 1;
+        }
+        state.inBuf.erase(0, start);
+    }
+
+    // Retorna false se o frame deve esperar (limite de taxa atingido)
+    bool handleFrame(ConnectionState& state, const string& jsonStr) {
+        json j;
+        try {
+            j = json::parse(jsonStr);
+        } catch (const json::parse_error& e) {
+            cout << "JSON parse error in handleClient: " << e.what() << endl;
+            cout << "Received string: '" << jsonStr << "'" << endl;
+            cout << "String length: " << jsonStr.length() << endl;
+            return true; // Skip this message and continue
+        }
+
+        if (!j.contains("type")) {
+            cout << "Message missing type field: " << jsonStr << endl;
+            return true;
+        }
+
+        if (!state.joined) {
+            handleJoinFrame(state, j);
+            return true;
+        }
+
+        string type = j.at("type");
+        int threadId = state.threadId;
+        unsigned generation = state.generation;
+        bool chat = type == "C2S_SEND_GROUP_MESSAGE";
+        bool roomScoped = chat || type == "C2S_INTERMEDIATE_VALUE" || type == "C2S_ROUND2_COMPLETED" ||
+                          type == "C2S_KEY_DELIVERY" || type == "C2S_SYNC_MEMBERS" || type == "C2S_LEAVE_ROOM" ||
+                          type == "C2S_FETCH_HISTORY";
+
+        // Demultiplexa pelo stream: o frame vai para o executor da sala, sem passar pelas outras
+        Room* room = nullptr;
+        if (roomScoped) {
+            StreamId stream = defaultRoom->id;
+            auto found = j.find("stream");
+            if (found != j.end() && found->is_number_unsigned()) {
+                stream = found->get<StreamId>();
+            }
+            auto joined = state.streams.find(stream);
+            if (joined == state.streams.end()) {
+                cout << "Ignoring " << type << " from user " << state.username << " for stream " << stream
+                     << " it is not in" << endl;
+                return true;
+            }
+            room = joined->second.room;
+        }
+
+        if (!admitFrame(state, jsonStr.size(), chat ? room : nullptr)) {
+            return false;
+        }
+
+        try {
+
+            if (chat) {
+                if (overloaded) {
+                    // Sobrecarga global: a mensagem é descartada e o remetente avisado
+                    sendSlowDown(state, "overload", OVERLOAD_CHECK_INTERVAL.count());
+                    return true;
+                }
+
+                // O frame de saída é montado aqui, em paralelo, até o campo "seq"; o executor
+                // só distribui. O log da sala põe a sequência entre as duas partes, sob o mutex
+                // dele, e guarda o frame como ele sai.
+                // O servidor não conhece as chaves, apenas repassa a época usada
+                ull epoch = j.at("payload").value("epochId", 0ULL);
+                const json& payload = j.at("payload");
+                string head = "{\"type\":\"S2C_BROADCAST_GROUP_MESSAGE\",\"stream\":" + to_string(room->id) +
+                              ",\"payload\":{\"sender\":" + json(state.username).dump() +
+                              ",\"ciphertext\":" + payload.at("ciphertext").dump() +
+                              ",\"epochId\":" + to_string(epoch) + ",\"seq\":";
+                auto frame = room->history->append(epoch, wallMs(), move(head), "}}");
+
+                if (!fanOut(*room, threadId, generation, frame)) {
+                    // Join ainda não publicado: o executor decide depois de processá-lo
+                    room->executor.post([this, room, threadId, generation, frame] {
+                        if (isMember(*room, threadId, generation)) {
+                            broadcastFrame(*room, frame, threadId, EgressClass::Chat);
+                        }
+                    });
+                }
+
+            } else if (type == "C2S_INTERMEDIATE_VALUE") {
+                // Cliente enviou seu valor intermediário (rodada 1)
+                json intermediateValue = j.at("payload").at("intermediateValue");
+                json proof = j.at("payload").value("proof", json());
+                ull epoch = j.at("payload").value("epochId", 0ULL);
+                room->executor.post([this, room, threadId, generation, intermediateValue, proof, epoch] {
+                    handleKeyExchangeRound1(*room, threadId, generation, intermediateValue, proof, epoch);
+                });
+
+            } else if (type == "C2S_ROUND2_COMPLETED") {
+                // Cliente completou rodada 2
+                ull epoch = j.contains("payload") ? j.at("payload").value("epochId", 0ULL) : 0ULL;
+                json nextPublicKey = j.contains("payload") ? j.at("payload").value("nextPublicKey", json()) : json();
+                json keyConfirmation = j.contains("payload") ? j.at("payload").value("keyConfirmation", json()) : json();
+                room->executor.post([this, room, threadId, generation, epoch, nextPublicKey, keyConfirmation] {
+                    handleKeyExchangeRound2(*room, threadId, generation, epoch, nextPublicKey, keyConfirmation);
+                });
+
+            } else if (type == "C2S_KEY_DELIVERY") {
+                // Chave da época nova cifrada para quem acabou de entrar
+                ull epoch = j.at("payload").value("epochId", 0ULL);
+                json wrappedKey = j.at("payload").at("wrappedKey");
+                json keyConfirmation = j.at("payload").value("keyConfirmation", json());
+                room->executor.post([this, room, threadId, generation, epoch, wrappedKey, keyConfirmation] {
+                    handleKeyDelivery(*room, threadId, generation, epoch, wrappedKey, keyConfirmation);
+                });
+
+            } else if (type == "C2S_SYNC_MEMBERS") {
+                // Cliente detectou um buraco nas versões da lista de membros
+                ull knownVersion = j.at("payload").at("version").get<ull>();
+                room->executor.post([this, room, threadId, generation, knownVersion] {
+                    if (isMember(*room, threadId, generation)) {
+                        syncMembers(*room, threadId, knownVersion);
+                    }
+                });
+
+            } else if (type == "C2S_FETCH_HISTORY") {
+                ull fromSeq = j.at("payload").value("fromSeq", 0ULL);
+                size_t limit = min<size_t>(j.at("payload").value("limit", HISTORY_FETCH_FRAMES), HISTORY_FETCH_FRAMES);
+                fetchHistory(threadId, generation, *room, fromSeq, limit);
+
+            } else if (type == "C2S_JOIN_ROOM") {
+                string name = j.at("payload").at("room");
+                if (name.empty() || name.size() > ROOM_NAME_LIMIT) {
+                    cout << "Invalid room name from user " << state.username << endl;
+                    return true;
+                }
+                Room& next = findOrCreateRoom(name);
+                if (state.streams.count(next.id)) {
+                    return true;
+                }
+                if (state.streams.size() >= STREAMS_PER_CONNECTION) {
+                    cout << "User " << state.username << " is already in " << STREAMS_PER_CONNECTION
+                         << " rooms, ignoring join to " << name << endl;
+                    return true;
+                }
+                enterRoom(state, next);
+
+            } else if (type == "C2S_LEAVE_ROOM") {
+                leaveRoom(state, *room, "USER_LEFT");
+
+            } else if (type == "C2S_LOGOUT") {
+                // Saída intencional: ao fechar, sai das salas na hora em vez de esperar retomada
+                sessions[threadId].resumable = false;
+
+            } else if (type == "PING") {
+                json pong;
+                pong["type"] = "PONG";
+                pong["payload"]["ts"] = j.at("payload").at("ts");
+                state.outBuf.append(pong.dump());
+                state.outBuf.push_back('\n');
+
+            } else if (type == "PONG") {
+                long long sentAt = j.at("payload").at("ts").get<long long>();
+                long long rtt = nowUs() - sentAt;
+                if (rtt >= 0) {
+                    heartbeatRtt.record(rtt);
+                }
+            }
+        } catch (const std::exception& e) {
+            cout << "Error handling " << type << " from user " << state.username
+                 << ": " << e.what() << endl;
+        }
+        return true;
+    }
+
+    // Confere os token buckets da conexão (todo frame) e da sala (chat). Só consome
+    // quando todos têm saldo; senão suspende a leitura pelo maior tempo de espera.
+    bool admitFrame(ConnectionState& state, size_t bytes, Room* chatRoom) {
+        long long now = nowUs();
+        // Os baldes da conexão são só desta thread: conferir e depois consumir é seguro
+        long long wait = max(state.messageBucket.delayFor(1, now), state.byteBucket.delayFor(bytes, now));
+        if (wait == 0 && chatRoom) {
+            // Cada byte de chat sai uma vez para cada outro membro da sala. O snapshot pode
+            // ainda estar vazio (primeira mensagem numa sala nova, antes do publishRecipients).
+            size_t size = roomSize(*chatRoom, state.threadId);
+            double roomBytes = (double)bytes * (size > 1 ? size - 1 : 1);
+            // Os baldes da sala são divididos entre as threads: quem decide é o tryConsume
+            // atômico, e o que um balde já consumiu é devolvido se o outro recusar
+            wait = chatRoom->messageBucket.tryConsume(1, now);
+            if (wait == 0) {
+                wait = chatRoom->byteBucket.tryConsume(roomBytes, now);
+                if (wait > 0) {
+                    chatRoom->messageBucket.refund(1);
+                }
+            }
+        }
+        if (wait > 0) {
+            state.throttledUntilUs = now + wait;
+            if (now - state.lastSlowDownUs >= SLOW_DOWN_NOTICE_INTERVAL.count() * 1000) {
+                state.lastSlowDownUs = now;
+                sendSlowDown(state, "rate", (wait + 999) / 1000);
+            }
+            return false;
+        }
+        state.messageBucket.tryConsume(1, now);
+        state.byteBucket.tryConsume(bytes, now);
+        return true;
+    }
+
+    // Lê os frames direto dos segmentos, já serializados, e os envia como bulk seguidos
+    // de S2C_HISTORY_END; mensagens novas continuam chegando pela classe de chat
+    void fetchHistory(int threadId, unsigned generation, Room& room, ull fromSeq, size_t limit) {
+        string frames;
+        uint64_t nextSeq = 0;
+        size_t count = room.history->read(fromSeq, limit, HISTORY_FETCH_BYTES, frames, nextSeq);
+        if (count > 0) {
+            frames.pop_back();  // drainEgress já põe o '\n' do último frame
+            pushEgress(threadId, generation, make_shared<const string>(move(frames)), EgressClass::Bulk);
+        }
+
+        json end = roomFrame(room, "S2C_HISTORY_END");
+        end["payload"]["fromSeq"] = fromSeq;
+        end["payload"]["count"] = count;
+        end["payload"]["nextSeq"] = nextSeq;
+        end["payload"]["lastSeq"] = room.history->lastSeq();
+        // Vai depois dos frames, na mesma classe, mas nunca é descartado: sem ele o cliente
+        // ficaria esperando o fim do /history para sempre
+        pushEgress(threadId, generation, make_shared<const string>(end.dump()), EgressClass::Bulk, false);
+    }
+
+    void sendSlowDown(ConnectionState& state, const string& reason, long long retryAfterMs) {
+        json slowDown;
+        slowDown["type"] = "S2C_SLOW_DOWN";
+        slowDown["payload"]["reason"] = reason;
+        slowDown["payload"]["retryAfterMs"] = retryAfterMs;
+        state.outBuf.append(slowDown.dump());
+        state.outBuf.push_back('\n');
+    }
+
+    size_t roomSize(Room& room, int threadId) {
+        auto guard = room.fanoutEpochs.pin(threadId);
+        return room.recipients.read()->recipients.size();
+    }
+
+    // Distribui a mensagem a partir do snapshot publicado, sem passar pelo executor.
+    // Retorna false se o remetente ainda não aparece no snapshot.
+    bool fanOut(Room& room, int threadId, unsigned generation, const shared_ptr<const string>& frame) {
+        auto guard = room.fanoutEpochs.pin(threadId);
+        const RecipientList* list = room.recipients.read();
+        if (!list->contains(threadId, generation)) {
+            return false;
+        }
+        deliver(*list, threadId, frame, EgressClass::Chat);
+        return true;
+    }
+
+    void handleJoinFrame(ConnectionState& state, const json& j) {
+        cout << "buffer " << j.dump() << endl << endl;
+
+        if (!j.contains("payload")) {
+            cout << "Invalid JSON structure - missing required fields" << endl;
+            cout << "JSON: " << j.dump() << endl;
+            return;
+        }
+
+        string type = j.at("type");
+        if (type == "C2S_RESUME") {
+            handleResume(state, j.at("payload"));
+            return;
+        }
+        if (type != "C2S_AUTHENTICATE_AND_JOIN") {
+            cout << "Unexpected message type: " << type << endl;
+            return;
+        }
+
+        if (!j.at("payload").contains("username") || !j.at("payload").contains("publicKey")) {
+            cout << "Invalid payload structure - missing username or publicKey" << endl;
+            cout << "Payload: " << j.at("payload").dump() << endl;
+            return;
+        }
+
+        string username;
+        json publicKey;
+        string keyGroup;
+        try {
+            username = j.at("payload").at("username");
+            publicKey = j.at("payload").at("publicKey");
+            // Clientes antigos não mandam o grupo: são do MODP
+            keyGroup = j.at("payload").value("keyGroup", "modp");
+            if (!isKnownKeyGroup(keyGroup) || (!publicKey.is_number_unsigned() && !publicKey.is_string())) {
+                throw invalid_argument("unknown key group or malformed public key");
+            }
+        } catch (const std::exception& e) {
+            cout << "Invalid join payload: " << e.what() << endl;
+            return;
+        }
+
+        int threadId = state.threadId;
+        unsigned generation = state.generation;
+        {
+            lock_guard<mutex> lock(namesMutex);
+            if (!namesInUse.insert(username).second) {
+                cout << "Username " << username << " already in use, rejecting client on thread " << threadId << endl;
+                json takenMsg;
+                takenMsg["type"] = "S2C_USER_NOTIFICATION";
+                takenMsg["payload"]["event"] = "USERNAME_TAKEN";
+                takenMsg["payload"]["username"] = username;
+                state.outBuf.append(takenMsg.dump());
+                state.outBuf.push_back('\n');
+                evictClient(threadId, generation, "username already in use");
+                return;
+            }
+        }
+
+        state.joined = true;
+        state.username = username;
+        state.publicKey = publicKey;
+        state.keyGroup = keyGroup;
+        sessions[threadId].authGeneration = generation;
+        armIdleTimeout(threadId, generation, IDLE_TIMEOUT);
+        issueResumeToken(state);
+        enterRoom(state, *defaultRoom);
+    }
+
+    // Token aleatório, trocado a cada autenticação ou retomada. É a única credencial da
+    // retomada, então os 128 bits vêm do CSPRNG do kernel e não de um gerador previsível.
+    void issueResumeToken(ConnectionState& state) {
+        uint8_t bytes[16];
+        size_t filled = 0;
+        while (filled < sizeof(bytes)) {
+            ssize_t got = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                throw runtime_error(string("getrandom failed: ") + strerror(errno));
+            }
+            filled += got;
+        }
+        char token[33];
+        for (size_t i = 0; i < sizeof(bytes); ++i) {
+            snprintf(token + 2 * i, 3, "%02x", bytes[i]);
+        }
+        state.resumeToken = token;
+
+        json session;
+        session["type"] = "S2C_SESSION";
+        session["payload"]["token"] = state.resumeToken;
+        session["payload"]["resumeGraceMs"] = config.resumeGrace.count();
+        state.outBuf.append(session.dump());
+        state.outBuf.push_back('\n');
+    }
+
+    // A conexão caiu: o slot fica reservado e o membro continua nas salas até o prazo
+    void parkSession(ConnectionState& state) {
+        ParkedSession parked{state.threadId, state.generation, state.username, state.publicKey, state.keyGroup, {}, 0};
+        for (auto& entry : state.streams) {
+            parked.rooms.push_back(entry.second.room);
+        }
+        sessions[state.threadId].parked = true;
+        cout << "Client " << state.username << " on thread " << state.threadId << " dropped, holding session for "
+             << config.resumeGrace.count() << " ms" << endl;
+
+        lock_guard<mutex> lock(parkedMutex);
+        string token = state.resumeToken;
+        parked.expiry = timers.schedule(config.resumeGrace, [this, token] { expireParkedSession(token); });
+        parkedSessions[token] = move(parked);
+    }
+
+    void expireParkedSession(const string& token) {
+        ParkedSession parked;
+        {
+            lock_guard<mutex> lock(parkedMutex);
+            auto found = parkedSessions.find(token);
+            if (found == parkedSessions.end()) {
+                return;  // Retomada antes do prazo
+            }
+            parked = move(found->second);
+            parkedSessions.erase(found);
+        }
+        cout << "Session of " << parked.username << " expired without resume" << endl;
+
+        int slot = parked.slot;
+        unsigned generation = parked.generation;
+        for (Room* room : parked.rooms) {
+            room->executor.post([this, room, slot, generation] {
+                handleLeave(*room, slot, generation, "USER_DISCONNECTED");
+            });
+        }
+        {
+            lock_guard<mutex> lock(namesMutex);
+            namesInUse.erase(parked.username);
+        }
+        // As saídas já estão nas filas dos executores, antes de qualquer join de quem reusar o slot
+        sessions[slot].parked = false;
+    }
+
+    // Reassume uma sessão estacionada na conexão nova. Para cada sala o cliente informa a
+    // última sequência de chat e a versão da lista de membros que viu.
+    void handleResume(ConnectionState& state, const json& payload) {
+        string token = payload.value("token", "");
+        ParkedSession parked;
+        {
+            lock_guard<mutex> lock(parkedMutex);
+            auto found = parkedSessions.find(token);
+            if (found == parkedSessions.end()) {
+                json failed;
+                failed["type"] = "S2C_RESUME_FAILED";
+                failed["payload"]["reason"] = "unknown or expired token";
+                state.outBuf.append(failed.dump());
+                state.outBuf.push_back('\n');
+                return;
+            }
+            parked = move(found->second);
+            parkedSessions.erase(found);
+            timers.cancel(parked.expiry);
+        }
+
+        int threadId = state.threadId;
+        unsigned generation = state.generation;
+        state.joined = true;
+        state.username = parked.username;
+        state.publicKey = parked.publicKey;
+        state.keyGroup = parked.keyGroup;
+        sessions[threadId].authGeneration = generation;
+        armIdleTimeout(threadId, generation, IDLE_TIMEOUT);
+        issueResumeToken(state);
+        cout << "Client " << state.username << " resumed on thread " << threadId << " (was " << parked.slot << ")" << endl;
+
+        unordered_map<StreamId, pair<ull, ull>> seen;  // Stream -> (lastSeq, membershipVersion)
+        if (payload.contains("streams")) {
+            for (const json& entry : payload.at("streams")) {
+                seen[entry.at("stream").get<StreamId>()] = {entry.value("lastSeq", 0ULL), entry.value("membershipVersion", 0ULL)};
+            }
+        }
+
+        json resumed;
+        resumed["type"] = "S2C_RESUMED";
+        resumed["payload"]["streams"] = json::array();
+        for (Room* room : parked.rooms) {
+            unsigned ticket = ++state.lastTicket;
+            state.streams[room->id] = {room, ticket};
+            resumed["payload"]["streams"].push_back(room->id);
+            auto known = seen.find(room->id);
+            ull lastSeq = known != seen.end() ? known->second.first : 0;
+            ull version = known != seen.end() ? known->second.second : 0;
+            int oldSlot = parked.slot;
+            unsigned oldGeneration = parked.generation;
+            string username = state.username;
+            json publicKey = state.publicKey;
+            string keyGroup = state.keyGroup;
+            room->executor.post([=] {
+                reattach(*room, oldSlot, oldGeneration, threadId, generation, ticket, username, publicKey, keyGroup,
+                         lastSeq, version);
+            });
+        }
+        state.outBuf.append(resumed.dump());
+        state.outBuf.push_back('\n');
+        sessions[parked.slot].parked = false;
+    }
+
+    Room& findOrCreateRoom(const string& name) {
+        lock_guard<mutex> lock(roomsMutex);
+        unique_ptr<Room>& room = rooms[name];
+        if (!room) {
+            // Streams começam em 1 e também escolhem o executor, em rodízio
+            StreamId id = ++lastStream;
+            room = make_unique<Room>(id, name, *executors[id % executors.size()]);
+            room->messageBucket.configure(config.roomMessageRate, config.roomMessageRate * RATE_BURST_SECONDS);
+            room->byteBucket.configure(config.roomByteRate, config.roomByteRate * RATE_BURST_SECONDS);
+            room->history = make_unique<MessageLog>(historyDirectory(name), MessageLog::Limits{
+                config.historySegmentBytes, config.historyMaxBytes,
+                chrono::duration_cast<chrono::milliseconds>(config.historyMaxAge).count()});
+            cout << "Created room " << name << " (stream " << id << ")" << endl;
+        }
+        return *room;
+    }
+
+    // Um diretório por sala; o nome vai em hex porque pode ter qualquer caractere
+    string historyDirectory(const string& name) const {
+        if (config.historyDir.empty()) {
+            return "";
+        }
+        static const char* digits = "0123456789abcdef";
+        string encoded;
+        for (unsigned char c : name) {
+            encoded.push_back(digits[c >> 4]);
+            encoded.push_back(digits[c & 0xf]);
+        }
+        return config.historyDir + "/" + encoded;
+    }
+
+    void forEachRoom(const function<void(Room&)>& visit) {
+        lock_guard<mutex> lock(roomsMutex);
+        for (auto& entry : rooms) {
+            visit(*entry.second);
+        }
+    }
+
+    void enterRoom(ConnectionState& state, Room& room) {
+        unsigned ticket = ++state.lastTicket;
+        state.streams[room.id] = {&room, ticket};
+        Room* target = &room;
+        int threadId = state.threadId;
+        unsigned generation = state.generation;
+        string username = state.username;
+        json publicKey = state.publicKey;
+        string keyGroup = state.keyGroup;
+        room.executor.post([this, target, threadId, generation, ticket, username, publicKey, keyGroup] {
+            handleJoin(*target, threadId, generation, ticket, username, publicKey, keyGroup);
+        });
+    }
+
+    void leaveRoom(ConnectionState& state, Room& left, const string& event) {
+        state.streams.erase(left.id);
+        Room* room = &left;
+        int threadId = state.threadId;
+        unsigned generation = state.generation;
+        room->executor.post([this, room, threadId, generation, event] {
+            handleLeave(*room, threadId, generation, event);
+        });
+    }
+
+    // ========================================================================
+    // Tarefas dos executores de sala: únicas que tocam users, members e a troca de chaves
+    // de uma sala. Cada sala fica presa ao executor escolhido quando foi criada.
+    // ========================================================================
+
+    // Todo frame de uma sala leva o stream dela; o mesmo buffer serve a todos os destinatários
+    static json roomFrame(const Room& room, const char* type) {
+        json j;
+        j["type"] = type;
+        j["stream"] = room.id;
+        return j;
+    }
+
+    bool isMember(const Room& room, int threadId, unsigned generation) const {
+        return generation != 0 && room.joinedGeneration[threadId] == generation;
+    }
+
+    void handleJoin(Room& room, int threadId, unsigned generation, unsigned ticket, const string& username,
+                    const json& publicKey, const string& keyGroup) {
+        // A conexão pode ter caído entre o join e esta tarefa
+        if (sessions[threadId].generation != generation || sessions[threadId].socket == -1) {
+            cout << "Client on thread " << threadId << " left before joining " << room.name << ", skipping..." << endl;
+            return;
+        }
+        if (isMember(room, threadId, generation)) {
+            room.users[threadId].streamTicket = ticket;
+            return;
+        }
+
+        // Todos na sala fazem o Burmester-Desmedt no mesmo grupo
+        if (room.members.empty()) {
+            room.keyGroup = keyGroup;
+        } else if (keyGroup != room.keyGroup) {
+            cout << "Client " << username << " uses key group " << keyGroup << ", but " << room.name
+                 << " uses " << room.keyGroup << ", skipping..." << endl;
+            // Libera o stream antes do aviso: corrigido o --key-group, o cliente pode tentar de novo
+            releaseStream(room, threadId, generation, ticket);
+            // Sem "stream": o cliente não conhece a sala; o stream vai no payload para ele sair dela
+            json mismatchMsg;
+            mismatchMsg["type"] = "S2C_USER_NOTIFICATION";
+            mismatchMsg["payload"]["event"] = "KEY_GROUP_MISMATCH";
+            mismatchMsg["payload"]["room"] = room.name;
+            mismatchMsg["payload"]["stream"] = room.id;
+            mismatchMsg["payload"]["keyGroup"] = room.keyGroup;
+            pushEgress(threadId, generation, make_shared<const string>(mismatchMsg.dump()), EgressClass::Control);
+            return;
+        }
+
+        // Salva o membro (o username é único no servidor, checado na autenticação)
+        MemberId memberId = room.members.add(username, publicKey, threadId);
+        if (memberId == NO_MEMBER) {
+            cout << "Username " << username << " already in room " << room.name << ", skipping..." << endl;
+            releaseStream(room, threadId, generation, ticket);
+            return;
+        }
+        recordMembershipChange(room, true, room.members.get(memberId));
+
+        User& user = room.users[threadId];
+        user = User();
+        user.memberId = memberId;
+        user.username = username;
+        user.publicKey = publicKey;
+        user.streamTicket = ticket;
+        room.joinedGeneration[threadId] = generation;
+        publishRecipients(room);
+
+        json joinedMsg = roomFrame(room, "S2C_ROOM_JOINED");
+        joinedMsg["payload"]["room"] = room.name;
+        // Mensagens até esta sequência são histórico para quem está entrando
+        joinedMsg["payload"]["lastSeq"] = room.history->lastSeq();
+        sendTo(room, threadId, make_shared<const string>(joinedMsg.dump()), EgressClass::Control);
+
+        json welcomeMsg = roomFrame(room, "S2C_USER_NOTIFICATION");
+        welcomeMsg["payload"]["event"] = "USER_JOINED";
+        welcomeMsg["payload"]["username"] = username;
+
+        cout << "[" << room.name << "] Client " << welcomeMsg.dump() << endl;
+        broadcastMessage(room, welcomeMsg.dump(), threadId, EgressClass::Membership);
+        // Quem entrou recebe a lista completa, os demais apenas o delta
+        broadcastMembershipChange(room, room.membershipLog.back(), threadId);
+        sendMembersSnapshot(room, threadId);
+
+        // Inicia nova troca de chaves quando um usuário entra, a completa só se a rápida não servir
+        if (room.members.size() > 1 && !startFastJoin(room, memberId)) {
+            scheduleRekey(room);
+        }
+    }
+
+    // Saída da sala: a conexão caiu (USER_DISCONNECTED) ou pediu para sair (USER_LEFT)
+    void handleLeave(Room& room, int threadId, unsigned generation, const string& event) {
+        if (!isMember(room, threadId, generation)) {
+            return;
+        }
+
+        // A conexão apaga o stream antes de ver qualquer frame posterior, então um novo
+        // C2S_JOIN_ROOM depois do S2C_ROOM_LEFT não é ignorado
+        releaseStream(room, threadId, generation, room.users[threadId].streamTicket);
+
+        // Quem saiu pedindo, ou foi tirado só desta sala, precisa saber que o stream acabou
+        if (event != "USER_DISCONNECTED") {
+            json leftMsg = roomFrame(room, "S2C_ROOM_LEFT");
+            leftMsg["payload"]["room"] = room.name;
+            sendTo(room, threadId, make_shared<const string>(leftMsg.dump()), EgressClass::Control);
+        }
+
+        json disconnectMsg = roomFrame(room, "S2C_USER_NOTIFICATION");
+        disconnectMsg["payload"]["event"] = event;
+        disconnectMsg["payload"]["username"] = room.users[threadId].username;
+        cout << "[" << room.name << "] Client " << disconnectMsg << endl;
+
+        // Sai do snapshot antes dos avisos: quem saiu não recebe mais nada desta sala
+        room.joinedGeneration[threadId] = 0;
+        publishRecipients(room);
+
+        // Remove usuário da lista de membros do grupo
+        removeMember(room, room.users[threadId].memberId);
+
+        // Reseta completamente a troca de chaves quando um usuário desconecta
+        if (room.keyExchangeInProgress) {
+            cout << "User " << room.users[threadId].username << " disconnected during key exchange. Restarting..." << endl;
+            abortKeyExchange(room);
+        }
+
+        room.users[threadId] = User();
+
+        broadcastMessage(room, disconnectMsg.dump(), -1, EgressClass::Membership); // broadcast to all
+
+        // Limpa usuários inativos antes de iniciar nova troca de chaves
+        cleanupInactiveUsers(room);
+
+        // Inicia nova troca de chaves se ainda há usuários suficientes
+        if (room.members.size() >= 2) {
+            cout << "Starting new key exchange after user disconnect. Members: " << room.members.size() << endl;
+            scheduleRekey(room);
+        } else if (room.members.size() == 1) {
+            // Apenas 1 usuário restante, envia comando para gerar chave individual
+            cout << "Only 1 user remaining. Sending individual key reset command. Members: " << room.members.size() << endl;
+            json individualKeyMsg = roomFrame(room, "S2C_INDIVIDUAL_KEY_RESET");
+            individualKeyMsg["payload"]["message"] = "You are now alone. Generating new individual key.";
+            room.currentEpoch = ++epochCounter;
+            room.fastJoins = 0;
+            individualKeyMsg["payload"]["epochId"] = room.currentEpoch;
+            broadcastMessage(room, individualKeyMsg.dump(), -1, EgressClass::Control);
+        } else {
+            cout << "No users remaining in " << room.name << ". Members: " << room.members.size() << endl;
+            // Quem entrar na sala vazia começa de novo com a chave inicial
+            room.currentEpoch = 0;
+        }
+    }
+
+    // Move o membro do slot antigo para a conexão retomada sem mexer na lista de membros:
+    // a época atual continua valendo e o chat perdido é reenviado do histórico
+    void reattach(Room& room, int oldSlot, unsigned oldGeneration, int threadId, unsigned generation, unsigned ticket,
+                  const string& username, const json& publicKey, const string& keyGroup, ull lastSeq, ull knownVersion) {
+        if (sessions[threadId].generation != generation || sessions[threadId].socket == -1) {
+            return;  // A conexão nova também caiu; a sala resolve quando ela for tratada
+        }
+        if (!isMember(room, oldSlot, oldGeneration)) {
+            // Saiu da sala enquanto estava fora (ex.: não respondeu uma troca de chaves)
+            handleJoin(room, threadId, generation, ticket, username, publicKey, keyGroup);
+            return;
+        }
+
+        User user = move(room.users[oldSlot]);
+        room.users[oldSlot] = User();
+        room.joinedGeneration[oldSlot] = 0;
+        room.members.moveToSlot(user.memberId, threadId);
+        user.streamTicket = ticket;
+        room.users[threadId] = move(user);
+        room.joinedGeneration[threadId] = generation;
+        publishRecipients(room);
+        cout << "[" << room.name << "] " << username << " reattached on thread " << threadId << endl;
+
+        // Deltas que o cliente não viu (a lista só muda por entradas e saídas de outros)
+        syncMembers(room, threadId, knownVersion);
+        if (room.keyExchangeInProgress) {
+            // As rodadas foram para a conexão antiga: recomeça com o membro de volta
+            scheduleRekey(room);
+        }
+        if (lastSeq < room.history->lastSeq()) {
+            fetchHistory(threadId, generation, room, lastSeq + 1, RESUME_REPLAY_FRAMES);
+        }
+    }
+
+    void initiateKeyExchange(Room& room) {
+        if (room.keyExchangeInProgress) {
+            cout << "Key exchange already in progress, skipping..." << endl;
+            return;
+        }
+
+        if (room.members.size() < 2) {
+            cout << "Not enough group members for key exchange (need at least 2, got "
+                 << room.members.size() << ")" << endl;
+            return;
+        }
+
+        cout << "[" << room.name << "] Starting key exchange for " << room.members.size() << " members..." << endl;
+
+        room.keyExchangeInProgress = true;
+        room.pendingEpoch = ++epochCounter;
+        room.round1Completed = 0;
+        room.round2Completed = 0;
+
+        // Reset flags para todos os usuários
+        int activeUsers = 0;
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+            if (room.joinedGeneration[i] != 0) {
+                room.users[i].hasCalculatedIntermediate = false;
+                room.users[i].intermediateValue = nullptr;
+                room.users[i].intermediateProof = nullptr;
+                room.users[i].roundPublicKey = nullptr;
+                room.users[i].hasCompletedRound2 = false;
+                room.users[i].keyConfirmation = nullptr;
+                activeUsers++;
+            }
+        }
+
+        cout << "Active users: " << activeUsers << ", Group members: " << room.members.size() << endl;
+
+        // Envia comando para iniciar rodada 1
+        json round1Msg = roomFrame(room, "S2C_START_KEY_EXCHANGE_ROUND1");
+        round1Msg["payload"]["groupSize"] = room.members.size();
+        round1Msg["payload"]["epochId"] = room.pendingEpoch;
+        // Chave pública de cada membro nesta época: a anunciada na troca anterior ou a de entrada
+        json& publicKeys = round1Msg["payload"]["publicKeys"];
+        publicKeys = json::array();
+        for (MemberId id : room.members.ring()) {
+            const Member& member = room.members.get(id);
+            User& user = room.users[member.slot];
+            json key;
+            key["username"] = member.username;
+            key["publicKey"] = user.memberId == id && !user.nextPublicKey.is_null() ? user.nextPublicKey : member.publicKey;
+            if (user.memberId == id) {
+                user.roundPublicKey = key["publicKey"];
+            }
+            publicKeys.push_back(key);
+        }
+        broadcastMessage(room, round1Msg.dump(), -1, EgressClass::Control);
+        armRoundDeadline(room, 1);
+    }
+
+    // Entrada rápida: os membros avançam a chave atual com um hash de mão única e o membro
+    // mais antigo a entrega a quem entrou, cifrada com o segredo DH entre os dois. São O(1)
+    // mensagens em vez de duas rodadas com todos. Saídas, ou muitas entradas rápidas
+    // seguidas, continuam passando pela troca completa.
+    bool startFastJoin(Room& room, MemberId joinerId) {
+        if (config.fastJoinLimit == 0 || room.fastJoins >= config.fastJoinLimit || room.currentEpoch == 0 ||
+            room.keyExchangeInProgress || room.rekeyTimer) {
+            return false;
+        }
+        MemberId distributorId = NO_MEMBER;
+        for (MemberId id : room.members.ring()) {
+            if (id != joinerId && !sessions[room.members.get(id).slot].parked) {
+                distributorId = id;
+                break;
+            }
         }
-
-        // send the delimiter '\n'
-        char delimiter = '\n';
-        if (send(sockfd, &delimiter, 1, 0) != 1) {
+        if (distributorId == NO_MEMBER) {
             return false;
         }
+        const Member& joiner = room.members.get(joinerId);
+        const Member& distributor = room.members.get(distributorId);
 
+        room.keyExchangeInProgress = true;
+        room.fastJoiner = joinerId;
+        room.fastJoinDistributor = distributorId;
+        room.pendingEpoch = ++epochCounter;
+        cout << "[" << room.name << "] Fast join of " << joiner.username << ": epoch " << room.currentEpoch
+             << " -> " << room.pendingEpoch << ", key from " << distributor.username << endl;
+
+        json fastJoinMsg = roomFrame(room, "S2C_FAST_JOIN");
+        fastJoinMsg["payload"]["epochId"] = room.pendingEpoch;
+        fastJoinMsg["payload"]["fromEpoch"] = room.currentEpoch;
+        fastJoinMsg["payload"]["joiner"] = joiner.username;
+        fastJoinMsg["payload"]["joinerPublicKey"] = joiner.publicKey;
+        fastJoinMsg["payload"]["distributor"] = distributor.username;
+        broadcastMessage(room, fastJoinMsg.dump(), -1, EgressClass::Control);
+        armRoundDeadline(room, 0);
         return true;
     }
 
-    // Receives one full message terminated by '\n'
-    // Returns false on error/connection closed
-    bool recvAll(int sockfd, std::string &outMessage) {
-        static std::map<int, std::string> buffers;  // buffer per socket
-        char temp[1024];
-        outMessage.clear();
-
-        // Get or create buffer for this socket
-        auto& buffer = buffers[sockfd];
-
-        while (true) {
-            // Check if we already have a full line in the buffer
-            size_t pos = buffer.find('\n');
-            if (pos != std::string::npos) {
-                outMessage = buffer.substr(0, pos);  // extract message (without \n)
-                buffer.erase(0, pos + 1);            // remove processed part
-                return true;
-            }
-
-            // Need to read more data
-            ssize_t bytesReceived = recv(sockfd, temp, sizeof(temp), 0);
-            if (bytesReceived <= 0) {
-                // Clean up buffer for this socket
-                buffers.erase(sockfd);
-                return false; // error or connection closed
-            }
-
-            buffer.append(temp, bytesReceived);
+    void handleKeyDelivery(Room& room, int threadId, unsigned generation, ull epoch, const json& wrappedKey,
+                           const json& keyConfirmation) {
+        if (!isMember(room, threadId, generation)) {
+            return;
+        }
+        const User& user = room.users[threadId];
+        if (room.fastJoiner == NO_MEMBER || epoch != room.pendingEpoch || user.memberId != room.fastJoinDistributor) {
+            cout << "Unexpected key delivery from " << user.username << " (epoch " << epoch << "), skipping..." << endl;
+            return;
         }
+
+        // Fica no servidor: a confirmação de quem entrou tem que bater com ela
+        room.fastJoinConfirmation = keyConfirmation;
+        const Member& joiner = room.members.get(room.fastJoiner);
+        json deliveryMsg = roomFrame(room, "S2C_KEY_DELIVERY");
+        deliveryMsg["payload"]["epochId"] = epoch;
+        deliveryMsg["payload"]["from"] = user.username;
+        deliveryMsg["payload"]["fromPublicKey"] = user.publicKey;
+        deliveryMsg["payload"]["wrappedKey"] = wrappedKey;
+        sendTo(room, joiner.slot, make_shared<const string>(deliveryMsg.dump()), EgressClass::Control);
     }
 
+    // Agenda uma tarefa no executor da sala depois de 'delay'
+    TimerWheel::TimerId scheduleOnRoom(Room& room, chrono::milliseconds delay, Actor::Task task) {
+        Actor* executor = &room.executor;
+        return timers.schedule(delay, [executor, task] { executor->post(task); });
+    }
 
-    bool handleNewClient(int threadId) {
-        int clientSocket = clientSockets[threadId].load();
-        string jsonStr;
+    // Agrupa várias mudanças de membros seguidas em uma única troca de chaves
+    void scheduleRekey(Room& room) {
+        if (room.keyExchangeInProgress) {
+            // A troca em andamento usa uma lista de membros desatualizada
+            cout << "Membership changed during key exchange, aborting epoch " << room.pendingEpoch << endl;
+            abortKeyExchange(room);
+        }
+        if (room.rekeyTimer) {
+            timers.cancel(room.rekeyTimer);
+        }
+        // Outra lista de membros (ou outra falha): as repetições por chaves divergentes recomeçam
+        room.confirmationRetries = 0;
+        room.rekeyTimer = scheduleOnRoom(room, REKEY_DEBOUNCE, [this, &room] {
+            room.rekeyTimer = 0;
+            initiateKeyExchange(room);
+        });
+    }
 
+    void abortKeyExchange(Room& room) {
+        room.keyExchangeInProgress = false;
+        room.fastJoiner = NO_MEMBER;
+        room.fastJoinDistributor = NO_MEMBER;
+        room.fastJoinConfirmation = nullptr;
+        room.round1Completed = 0;
+        room.round2Completed = 0;
+        if (room.roundTimer) {
+            timers.cancel(room.roundTimer);
+            room.roundTimer = 0;
+        }
+    }
 
-        if (!recvAll(clientSocket, jsonStr)) {
-            cout << "Client disconnected before sending name on thread " << threadId << endl;
-            close(clientSocket);
-            clientSockets[threadId] = -1;
-            return false;
+    void armRoundDeadline(Room& room, int round) {
+        if (room.roundTimer) {
+            timers.cancel(room.roundTimer);
         }
+        ull epoch = room.pendingEpoch;
+        room.roundTimer = scheduleOnRoom(room, ROUND_TIMEOUT, [this, &room, epoch, round] {
+            onRoundDeadline(room, epoch, round);
+        });
+    }
 
-        cout << "buffer " << jsonStr << endl << endl;
-        
-        // Verifica se o JSON está completo
-        if (jsonStr.empty()) {
-            cout << "Empty JSON string received" << endl;
-            return false;
+    // Quem não respondeu a rodada a tempo é removido e a troca recomeça sem ele
+    void onRoundDeadline(Room& room, ull epoch, int round) {
+        if (!room.keyExchangeInProgress || epoch != room.pendingEpoch) {
+            return;
         }
-        
-        json j;
-        try {
-            j = json::parse(jsonStr);
-        } catch (const json::parse_error& e) {
-            cout << "JSON parse error: " << e.what() << endl;
-            cout << "Received string: '" << jsonStr << "'" << endl;
-            cout << "String length: " << jsonStr.length() << endl;
-            return false;
+        room.roundTimer = 0;
+
+        if (room.fastJoiner != NO_MEMBER) {
+            // A chave não chegou a quem entrou: a troca completa cuida de quem não responde
+            cout << "[" << room.name << "] Fast join for epoch " << epoch << " timed out, falling back to full key exchange" << endl;
+            abortKeyExchange(room);
+            scheduleRekey(room);
+            return;
         }
 
-        try
-        {
-            if (!j.contains("type") || !j.contains("payload")) {
-                cout << "Invalid JSON structure - missing required fields" << endl;
-                cout << "JSON: " << j.dump() << endl;
-                return false;
-            }
-            
-            string type = j.at("type");
-            if (type != "C2S_AUTHENTICATE_AND_JOIN") {
-                cout << "Unexpected message type: " << type << endl;
-                return false;
-            }
-            
-            if (!j.at("payload").contains("username") || !j.at("payload").contains("publicKey")) {
-                cout << "Invalid payload structure - missing username or publicKey" << endl;
-                cout << "Payload: " << j.at("payload").dump() << endl;
-                return false;
+        vector<int> stragglers;
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+            if (room.joinedGeneration[i] == 0) {
+                continue;
             }
-            
-            string username = j.at("payload").at("username");
-            ull publicKey = j.at("payload").at("publicKey").get<ull>();
-            
-            // Salva o membro
-            groupMembers.push_back({username, publicKey});
-
-            users[threadId].username = username;
-            users[threadId].publicKey = publicKey;
-            users[threadId].hasCalculatedIntermediate = false;
-            users[threadId].intermediateValue = 0;
-            clientNames[threadId] = username;
-
-            json welcomeMsg;
-            welcomeMsg["type"] = "S2C_USER_NOTIFICATION";
-            welcomeMsg["payload"]["event"] = "USER_JOINED";
-            welcomeMsg["payload"]["username"] = username;
-
-            cout << "Client " << welcomeMsg.dump() << endl;
-            broadcastMessage(welcomeMsg.dump(), clientSocket);
-            broadcastGroupMembersList();
-            
-            // Inicia nova troca de chaves quando um usuário entra
-            if (groupMembers.size() > 1) {
-                // Aguarda um pouco para garantir que todos os clientes receberam a lista atualizada
-                this_thread::sleep_for(chrono::milliseconds(100));
-                initiateKeyExchange();
+            const User& user = room.users[i];
+            bool done = round == 1 ? user.hasCalculatedIntermediate : user.hasCompletedRound2;
+            if (!done) {
+                stragglers.push_back(i);
             }
         }
-        catch(const std::exception& e)
-        {
-            std::cerr << e.what() << '\n';
-            throw e;
-        }
 
+        cout << "[" << room.name << "] Round " << round << " of epoch " << epoch << " timed out with "
+             << stragglers.size() << " straggler(s)" << endl;
+        abortKeyExchange(room);
 
-        return true;
+        // O straggler sai só desta sala: a conexão e as outras salas dele não são afetadas.
+        // A saída agenda a nova troca com os membros restantes.
+        for (int slot : stragglers) {
+            handleLeave(room, slot, room.joinedGeneration[slot], "USER_TIMED_OUT");
+        }
+
+        if (stragglers.empty()) {
+            scheduleRekey(room);
+        }
     }
 
-    void initiateKeyExchange() {
-        if (keyExchangeInProgress) {
-            cout << "Key exchange already in progress, skipping..." << endl;
+    void handleKeyExchangeRound1(Room& room, int threadId, unsigned generation, const json& intermediateValue,
+                                 const json& proof, ull epoch) {
+        // Verifica se o usuário ainda está ativo e conectado
+        if (!isMember(room, threadId, generation)) {
+            cout << "User on thread " << threadId << " is no longer active, skipping..." << endl;
             return;
         }
-        
-        if (groupMembers.size() < 2) {
-            cout << "Not enough group members for key exchange (need at least 2, got " 
-                 << groupMembers.size() << ")" << endl;
+
+        User& user = room.users[threadId];
+        // Verifica se o usuário ainda está na lista de membros do grupo
+        if (!room.members.contains(user.memberId)) {
+            cout << "User " << user.username << " is no longer in group, skipping..." << endl;
             return;
         }
-        
-        cout << "Starting key exchange for " << groupMembers.size() << " members..." << endl;
-        
-        keyExchangeInProgress = true;
-        round1Completed = 0;
-        round2Completed = 0;
-        
-        // Reset flags para todos os usuários
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (clientSockets[i] != -1) {
-                users[i].hasCalculatedIntermediate = false;
-                users[i].intermediateValue = 0;
-            }
+
+        // Resposta de uma troca de chaves que já foi abortada
+        if (!room.keyExchangeInProgress || epoch != room.pendingEpoch) {
+            cout << "Stale round 1 value from " << user.username << " (epoch " << epoch
+                 << ", expected " << room.pendingEpoch << "), skipping..." << endl;
+            return;
         }
-        
-        // Verifica se todos os usuários ativos estão na lista de membros
-        int activeUsers = 0;
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (clientSockets[i] != -1 && !users[i].username.empty()) {
-                activeUsers++;
-            }
+
+        if (user.hasCalculatedIntermediate) {
+            cout << "Duplicate round 1 value from " << user.username << ", skipping..." << endl;
+            return;
+        }
+
+        user.intermediateValue = intermediateValue;
+        user.intermediateProof = proof;
+        user.hasCalculatedIntermediate = true;
+        room.round1Completed++;
+
+        cout << "User " << user.username << " completed round 1. Progress: "
+             << room.round1Completed << "/" << room.members.size() << endl;
+
+        // Se todos completaram rodada 1, confere os valores e inicia rodada 2
+        if (room.round1Completed >= (int)room.members.size() && checkRound1(room)) {
+            startRound2(room);
         }
-        
-        cout << "Active users: " << activeUsers << ", Group members: " << groupMembers.size() << endl;
-        
-        // Envia comando para iniciar rodada 1
-        json round1Msg;
-        round1Msg["type"] = "S2C_START_KEY_EXCHANGE_ROUND1";
-        round1Msg["payload"]["groupSize"] = groupMembers.size();
-        broadcastMessage(round1Msg.dump(), -1);
     }
 
-    void handleKeyExchangeRound1(int threadId, ull intermediateValue) {
-        // Verifica se o threadId é válido
-        if (threadId < 0 || threadId >= MAX_CLIENTS) {
-            cout << "Invalid threadId in handleKeyExchangeRound1: " << threadId << endl;
-            return;
+    /**
+     * @brief Confere que os X_i fecham o anel antes de gastar a rodada 2 com eles.
+     * Se não fecham, as provas apontam quem mandou um valor errado: essa pessoa sai da
+     * sala e a troca recomeça na hora, sem ela. Retorna true se a rodada 2 pode começar.
+     */
+    bool checkRound1(Room& room) {
+        vector<int> slots;
+        for (MemberId id : room.members.ring()) {
+            int slot = room.members.get(id).slot;
+            if (room.users[slot].memberId != id || !room.users[slot].hasCalculatedIntermediate) {
+                return true;  // startRound2 já recomeça a troca nesse caso
+            }
+            slots.push_back(slot);
         }
-        
-        // Verifica se o usuário ainda está ativo e conectado
-        if (clientSockets[threadId] == -1 || users[threadId].username.empty()) {
-            cout << "User on thread " << threadId << " is no longer active, skipping..." << endl;
-            return;
+
+        vector<int> offenders;
+        bool closes = room.keyGroup == "ed25519" ? checkRound1<BdCheck::EdGroup>(room, slots, offenders)
+                                                 : checkRound1<BdCheck::ModpGroup>(room, slots, offenders);
+        if (closes) {
+            return true;
         }
-        
-        // Verifica se o usuário ainda está na lista de membros do grupo
-        bool userStillInGroup = false;
-        for (const auto& member : groupMembers) {
-            if (member.username == users[threadId].username) {
-                userStillInGroup = true;
-                break;
+
+        cout << "[" << room.name << "] Round 1 of epoch " << room.pendingEpoch << " does not close the ring, "
+             << offenders.size() << " offender(s)" << endl;
+        abortKeyExchange(room);
+        if (offenders.empty()) {
+            // Nenhuma prova falhou: não há a quem culpar, tenta de novo com a espera normal
+            scheduleRekey(room);
+            return false;
+        }
+
+        // Quem errou sai só desta sala; a conexão e as outras salas dele continuam
+        for (int slot : offenders) {
+            cout << "Rejecting " << room.users[slot].username << ": invalid round 1 value or proof" << endl;
+            handleLeave(room, slot, room.joinedGeneration[slot], "USER_REJECTED");
+        }
+        // handleLeave agendou a troca com a espera normal; os demais já estão prontos
+        if (room.rekeyTimer) {
+            timers.cancel(room.rekeyTimer);
+            room.rekeyTimer = 0;
+            initiateKeyExchange(room);
+        }
+        return false;
+    }
+
+    // Posições do anel (em 'slots') cujo valor, chave ou prova não confere vão para 'offenders'
+    template <class Group>
+    bool checkRound1(Room& room, const vector<int>& slots, vector<int>& offenders) {
+        const size_t n = slots.size();
+        vector<typename Group::Element> keys(n), values(n);
+        vector<typename Group::Proof> proofs(n);
+        for (size_t i = 0; i < n; ++i) {
+            const User& user = room.users[slots[i]];
+            if (!parseElement(user.roundPublicKey, keys[i]) || !parseElement(user.intermediateValue, values[i])) {
+                offenders.push_back(slots[i]);
+            } else if (!parseProof(user.intermediateProof, proofs[i])) {
+                // Sem prova só é problema se o anel não fechar; a conta abaixo decide
+                proofs[i] = typename Group::Proof();
             }
         }
-        
-        if (!userStillInGroup) {
-            cout << "User " << users[threadId].username << " is no longer in group, skipping..." << endl;
-            return;
+        if (!offenders.empty()) {
+            return false;
         }
-        
-        users[threadId].intermediateValue = intermediateValue;
-        users[threadId].hasCalculatedIntermediate = true;
-        round1Completed++;
-        
-        cout << "User " << users[threadId].username << " completed round 1. Progress: " 
-             << round1Completed << "/" << groupMembers.size() << endl;
-        
-        // Se todos completaram rodada 1, inicia rodada 2
-        if (round1Completed >= groupMembers.size()) {
-            startRound2();
+
+        vector<size_t> positions;
+        if (BdCheck::checkRound1<Group>(keys, values, proofs, room.pendingEpoch, positions)) {
+            return true;
+        }
+        for (size_t i : positions) {
+            offenders.push_back(slots[i]);
         }
+        return false;
     }
 
-    void startRound2() {
+    void startRound2(Room& room) {
         // Verifica se ainda há usuários suficientes para continuar
-        if (groupMembers.size() < 2) {
+        if (room.members.size() < 2) {
             cout << "Not enough users for round 2, aborting key exchange" << endl;
-            keyExchangeInProgress = false;
+            abortKeyExchange(room);
             return;
         }
-        
+
         // Envia todos os valores intermediários para todos os clientes
-        json round2Msg;
-        round2Msg["type"] = "S2C_START_KEY_EXCHANGE_ROUND2";
-        
+        json round2Msg = roomFrame(room, "S2C_START_KEY_EXCHANGE_ROUND2");
+        round2Msg["payload"]["epochId"] = room.pendingEpoch;
+
+        // Percorre o anel uma vez: cada membro já sabe em que slot está
         int validUsers = 0;
-        for (int i = 0; i < MAX_CLIENTS; ++i) {
-            if (clientSockets[i] != -1 && users[i].hasCalculatedIntermediate && !users[i].username.empty()) {
-                // Verifica se o usuário ainda está na lista de membros
-                bool userStillInGroup = false;
-                for (const auto& member : groupMembers) {
-                    if (member.username == users[i].username) {
-                        userStillInGroup = true;
-                        break;
-                    }
-                }
-                
-                if (userStillInGroup) {
-                    json member;
-                    member["username"] = users[i].username;
-                    member["intermediateValue"] = users[i].intermediateValue;
-                    round2Msg["payload"]["intermediateValues"].push_back(member);
-                    validUsers++;
-                }
+        for (MemberId id : room.members.ring()) {
+            const User& user = room.users[room.members.get(id).slot];
+            if (user.hasCalculatedIntermediate && user.memberId == id) {
+                json member;
+                member["username"] = user.username;
+                member["intermediateValue"] = user.intermediateValue;
+                round2Msg["payload"]["intermediateValues"].push_back(member);
+                validUsers++;
             }
         }
-        
-        cout << "Round 2: " << validUsers << " valid users out of " << groupMembers.size() << " group members" << endl;
-        
-        if (validUsers < groupMembers.size()) {
+
+        cout << "Round 2: " << validUsers << " valid users out of " << room.members.size() << " group members" << endl;
+
+        if (validUsers < (int)room.members.size()) {
             cout << "Some users are no longer valid, restarting key exchange" << endl;
-            keyExchangeInProgress = false;
-            round1Completed = 0;
-            round2Completed = 0;
+            abortKeyExchange(room);
             // Inicia nova troca de chaves
-            this_thread::sleep_for(chrono::milliseconds(100));
-            initiateKeyExchange();
+            scheduleRekey(room);
             return;
         }
-        
-        broadcastMessage(round2Msg.dump(), -1);
+
+        broadcastMessage(room, round2Msg.dump(), -1, EgressClass::Control);
+        armRoundDeadline(room, 2);
     }
 
-    void handleKeyExchangeRound2(int threadId) {
-        // Verifica se o threadId é válido
-        if (threadId < 0 || threadId >= MAX_CLIENTS) {
-            cout << "Invalid threadId in handleKeyExchangeRound2: " << threadId << endl;
-            return;
-        }
-        
+    void handleKeyExchangeRound2(Room& room, int threadId, unsigned generation, ull epoch, const json& nextPublicKey,
+                                 const json& keyConfirmation) {
         // Verifica se o usuário ainda está ativo e conectado
-        if (clientSockets[threadId] == -1 || users[threadId].username.empty()) {
+        if (!isMember(room, threadId, generation)) {
             cout << "User on thread " << threadId << " is no longer active, skipping..." << endl;
             return;
         }
-        
+
+        User& user = room.users[threadId];
         // Verifica se o usuário ainda está na lista de membros do grupo
-        bool userStillInGroup = false;
-        for (const auto& member : groupMembers) {
-            if (member.username == users[threadId].username) {
-                userStillInGroup = true;
-                break;
+        if (!room.members.contains(user.memberId)) {
+            cout << "User " << user.username << " is no longer in group, skipping..." << endl;
+            return;
+        }
+
+        if (!room.keyExchangeInProgress || epoch != room.pendingEpoch) {
+            cout << "Stale round 2 completion from " << user.username << " (epoch " << epoch
+                 << ", expected " << room.pendingEpoch << "), skipping..." << endl;
+            return;
+        }
+
+        // O membro já tem o par da próxima troca completa; vale mesmo que esta seja abortada
+        if (!nextPublicKey.is_null()) {
+            user.nextPublicKey = nextPublicKey;
+        }
+
+        if (room.fastJoiner != NO_MEMBER) {
+            // Na entrada rápida só quem entrou confirma; os demais derivam a chave sozinhos
+            if (user.memberId != room.fastJoiner) {
+                return;
+            }
+            if (!keyConfirmation.is_null() && !room.fastJoinConfirmation.is_null() &&
+                keyConfirmation != room.fastJoinConfirmation) {
+                // A chave não chegou íntegra: a troca completa refaz a chave com todos
+                cout << "[" << room.name << "] Fast join key for epoch " << epoch << " does not match, "
+                     << "falling back to full key exchange" << endl;
+                abortKeyExchange(room);
+                initiateKeyExchange(room);
+                return;
             }
+            finalizeKeyExchange(room);
+            return;
         }
-        
-        if (!userStillInGroup) {
-            cout << "User " << users[threadId].username << " is no longer in group, skipping..." << endl;
+
+        if (user.hasCompletedRound2) {
+            cout << "Duplicate round 2 completion from " << user.username << ", skipping..." << endl;
             return;
         }
-        
-        round2Completed++;
-        cout << "User " << users[threadId].username << " completed round 2. Progress: " 
-             << round2Completed << "/" << groupMembers.size() << endl;
-        
-        // Se todos completaram rodada 2, finaliza troca de chaves
-        if (round2Completed >= groupMembers.size()) {
-            finalizeKeyExchange();
+
+        user.hasCompletedRound2 = true;
+        user.keyConfirmation = keyConfirmation;
+        room.round2Completed++;
+        cout << "User " << user.username << " completed round 2. Progress: "
+             << room.round2Completed << "/" << room.members.size() << endl;
+
+        // Se todos completaram rodada 2 com a mesma chave, finaliza troca de chaves
+        if (room.round2Completed >= (int)room.members.size()) {
+            if (keyConfirmationsMatch(room)) {
+                finalizeKeyExchange(room);
+            } else {
+                retryKeyExchange(room);
+            }
+        }
+    }
+
+    // Os compromissos mandados na rodada 2 são todos iguais (clientes antigos não mandam)
+    bool keyConfirmationsMatch(Room& room) {
+        const json* first = nullptr;
+        for (MemberId id : room.members.ring()) {
+            const User& user = room.users[room.members.get(id).slot];
+            if (user.memberId != id || user.keyConfirmation.is_null()) {
+                continue;
+            }
+            if (first == nullptr) {
+                first = &user.keyConfirmation;
+            } else if (user.keyConfirmation != *first) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Os membros derivaram chaves diferentes: a época não é anunciada e a troca
+     * recomeça na hora, até KEY_CONFIRMATION_RETRIES vezes. Depois disso a sala fica na
+     * época atual até a lista de membros mudar, em vez de repetir a troca sem fim.
+     */
+    void retryKeyExchange(Room& room) {
+        ull epoch = room.pendingEpoch;
+        abortKeyExchange(room);
+        if (room.confirmationRetries < KEY_CONFIRMATION_RETRIES) {
+            room.confirmationRetries++;
+            cout << "[" << room.name << "] Key confirmations for epoch " << epoch << " do not match, retrying ("
+                 << room.confirmationRetries << "/" << KEY_CONFIRMATION_RETRIES << ")" << endl;
+            if (room.rekeyTimer) {
+                timers.cancel(room.rekeyTimer);
+                room.rekeyTimer = 0;
+            }
+            initiateKeyExchange(room);
+            return;
         }
+
+        cout << "[" << room.name << "] Key confirmations for epoch " << epoch << " still do not match after "
+             << KEY_CONFIRMATION_RETRIES << " retries, keeping epoch " << room.currentEpoch << endl;
+        room.confirmationRetries = 0;
+        json failedMsg = roomFrame(room, "S2C_USER_NOTIFICATION");
+        failedMsg["payload"]["event"] = "KEY_EXCHANGE_FAILED";
+        failedMsg["payload"]["epochId"] = epoch;
+        broadcastMessage(room, failedMsg.dump(), -1, EgressClass::Membership);
     }
 
-    void finalizeKeyExchange() {
-        keyExchangeInProgress = false;
-        cout << "Key exchange completed for all users!" << endl;
-        
+    void finalizeKeyExchange(Room& room) {
+        bool fastJoin = room.fastJoiner != NO_MEMBER;
+        abortKeyExchange(room);
+        room.currentEpoch = room.pendingEpoch;
+        room.fastJoins = fastJoin ? room.fastJoins + 1 : 0;
+        room.confirmationRetries = 0;
+        cout << "[" << room.name << "] Key exchange completed for all users! Epoch " << room.pendingEpoch << endl;
+
         // Notifica todos que a troca de chaves foi concluída
-        json finalMsg;
-        finalMsg["type"] = "S2C_KEY_EXCHANGE_COMPLETED";
-        broadcastMessage(finalMsg.dump(), -1);
+        json finalMsg = roomFrame(room, "S2C_KEY_EXCHANGE_COMPLETED");
+        finalMsg["payload"]["epochId"] = room.pendingEpoch;
+        broadcastMessage(room, finalMsg.dump(), -1, EgressClass::Control);
     }
-    
-    void cleanupInactiveUsers() {
+
+    void cleanupInactiveUsers(Room& room) {
         // Remove usuários que não estão mais ativos da lista de membros
-        auto it = groupMembers.begin();
-        while (it != groupMembers.end()) {
-            bool userStillActive = false;
-            for (int i = 0; i < MAX_CLIENTS; ++i) {
-                if (clientSockets[i] != -1 && users[i].username == it->username) {
-                    userStillActive = true;
-                    break;
-                }
-            }
-            
-            if (!userStillActive) {
-                cout << "Removing inactive user " << it->username << " from group members" << endl;
-                it = groupMembers.erase(it);
-            } else {
-                ++it;
+        vector<MemberId> ring = room.members.ring();
+        for (MemberId id : ring) {
+            const Member& member = room.members.get(id);
+            if (room.users[member.slot].memberId != id) {
+                cout << "Removing inactive user " << member.username << " from group members" << endl;
+                removeMember(room, id);
             }
         }
-        
+
         // Se após limpeza resta apenas 1 usuário, envia comando para chave individual
-        if (groupMembers.size() == 1) {
+        if (room.members.size() == 1) {
             cout << "After cleanup: only 1 user remaining. Sending individual key command." << endl;
-            json individualKeyMsg;
-            individualKeyMsg["type"] = "S2C_INDIVIDUAL_KEY_RESET";
+            json individualKeyMsg = roomFrame(room, "S2C_INDIVIDUAL_KEY_RESET");
             individualKeyMsg["payload"]["message"] = "Other users left. You are now alone. Generating new individual key.";
-            broadcastMessage(individualKeyMsg.dump(), -1);
+            room.currentEpoch = ++epochCounter;
+            room.fastJoins = 0;
+            individualKeyMsg["payload"]["epochId"] = room.currentEpoch;
+            broadcastMessage(room, individualKeyMsg.dump(), -1, EgressClass::Control);
         }
     }
 
-    void handleClient(int threadId) {
-        while (isRunning) {
-            int clientSocket = clientSockets[threadId].load();
-            if (clientSocket != -1) {
-                if (!handleNewClient(threadId)) {
-                    continue; // Wait for a new connection on this thread
-                }
+    void sendTo(Room& room, int threadId, const shared_ptr<const string>& frame, EgressClass cls) {
+        pushEgress(threadId, room.joinedGeneration[threadId], frame, cls);
+    }
 
-                string jsonStr;
-
-                while (isRunning) {
-                    cout << "recebi" << endl;
-                    if (!recvAll(clientSocket, jsonStr)) {
-                        json disconnectMsg;
-                        disconnectMsg["type"] = "S2C_USER_NOTIFICATION";
-                        disconnectMsg["payload"]["event"] = "USER_DISCONNECTED";
-                        disconnectMsg["payload"]["username"] = users[threadId].username;
-                        cout << "Client " << disconnectMsg << endl;
-
-                        // Remove usuário da lista de membros do grupo
-                        for (auto it = groupMembers.begin(); it != groupMembers.end(); ++it) {
-                            if (it->username == users[threadId].username) {
-                                groupMembers.erase(it);
-                                break;
-                            }
-                        }
-                        
-                        // Reseta completamente a troca de chaves quando um usuário desconecta
-                        if (keyExchangeInProgress) {
-                            cout << "User " << users[threadId].username << " disconnected during key exchange. Restarting..." << endl;
-                            keyExchangeInProgress = false;
-                            round1Completed = 0;
-                            round2Completed = 0;
-                        }
-                        
-                        close(clientSocket);
-                        clientSockets[threadId] = -1;
-                        clientNames[threadId] = "";
-                        users[threadId].username = "";
-                        users[threadId].publicKey = 0;
-                        users[threadId].hasCalculatedIntermediate = false;
-                        users[threadId].intermediateValue = 0;
-                        
-                        broadcastMessage(disconnectMsg.dump(), -1); // broadcast to all
-                        broadcastGroupMembersList(); // Atualiza lista de membros
-                        
-                        // Limpa usuários inativos antes de iniciar nova troca de chaves
-                        cleanupInactiveUsers();
-                        
-                        // Inicia nova troca de chaves se ainda há usuários suficientes
-                        if (groupMembers.size() >= 2) {
-                            cout << "Starting new key exchange after user disconnect. Members: " << groupMembers.size() << endl;
-                            // Aguarda um pouco para garantir que todos os clientes receberam a lista atualizada
-                            this_thread::sleep_for(chrono::milliseconds(100));
-                            initiateKeyExchange();
-                        } else if (groupMembers.size() == 1) {
-                            // Apenas 1 usuário restante, envia comando para gerar chave individual
-                            cout << "Only 1 user remaining. Sending individual key reset command. Members: " << groupMembers.size() << endl;
-                            json individualKeyMsg;
-                            individualKeyMsg["type"] = "S2C_INDIVIDUAL_KEY_RESET";
-                            individualKeyMsg["payload"]["message"] = "You are now alone. Generating new individual key.";
-                            broadcastMessage(individualKeyMsg.dump(), -1);
-                        } else {
-                            cout << "No users remaining after disconnect. Members: " << groupMembers.size() << endl;
-                        }
-                        
-                        break; // Exit inner loop to wait for a new connection
-                    }
+    // Coloca a mensagem na fila de saída do slot e acorda a thread da conexão. Com o
+    // cliente atrasado demais, as classes menos importantes são descartadas primeiro;
+    // 'sheddable' = false mantém o frame na sua classe (e na ordem dela) sem descartá-lo.
+    void pushEgress(int threadId, unsigned generation, const shared_ptr<const string>& frame, EgressClass cls,
+                    bool sheddable = true) {
+        Session& conn = sessions[threadId];
+        if (conn.parked.load(memory_order_relaxed)) {
+            return;  // Sem conexão: o chat perdido volta do histórico na retomada
+        }
+        if (sheddable && conn.backlog.load(memory_order_relaxed) >= EGRESS_SHED_BACKLOG[(int)cls]) {
+            shedFrames.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        conn.backlog++;
+        conn.egress[(int)cls].push({generation, frame});
+        wake(conn);
+    }
 
-                    json j;
-                    try {
-                        j = json::parse(jsonStr);
-                    } catch (const json::parse_error& e) {
-                        cout << "JSON parse error in handleClient: " << e.what() << endl;
-                        cout << "Received string: '" << jsonStr << "'" << endl;
-                        cout << "String length: " << jsonStr.length() << endl;
-                        continue; // Skip this message and continue
-                    }
+    // O executor tirou a conexão da sala: a thread dela apaga o stream (se ainda for a
+    // mesma entrada) antes dos frames enfileirados depois, como o S2C_ROOM_LEFT
+    void releaseStream(const Room& room, int threadId, unsigned generation, unsigned ticket) {
+        Session& conn = sessions[threadId];
+        if (conn.parked.load(memory_order_relaxed)) {
+            return;  // A retomada confere de novo cada sala
+        }
+        conn.backlog++;
+        conn.egress[(int)EgressClass::Control].push({generation, nullptr, room.id, ticket});
+        wake(conn);
+    }
 
-                    if (!j.contains("type")) {
-                        cout << "Message missing type field: " << jsonStr << endl;
-                        continue;
-                    }
-                    
-                    string type = j.at("type");
-
-                    if (type == "C2S_SEND_GROUP_MESSAGE") {
-                        json newJ;
-                        newJ["type"] = "S2C_BROADCAST_GROUP_MESSAGE";
-                        newJ["payload"]["sender"] = users[threadId].username;
-                        newJ["payload"]["ciphertext"] = j.at("payload").at("ciphertext");
-
-                        string newJasonStr = newJ.dump();
-
-                        cout << newJasonStr << endl;
-                        
-                        broadcastMessage(newJasonStr, clientSocket);
-                        
-                    } else if (type == "C2S_INTERMEDIATE_VALUE") {
-                        // Cliente enviou seu valor intermediário (rodada 1)
-                        try {
-                            ull intermediateValue = j.at("payload").at("intermediateValue").get<ull>();
-                            handleKeyExchangeRound1(threadId, intermediateValue);
-                        } catch (const std::exception& e) {
-                            cout << "Error parsing intermediate value from user " << users[threadId].username 
-                                 << ": " << e.what() << endl;
-                        }
-                        
-                    } else if (type == "C2S_ROUND2_COMPLETED") {
-                        // Cliente completou rodada 2
-                        handleKeyExchangeRound2(threadId);
-                    }
-                }
-            } else {
-                // If no client, sleep briefly to avoid busy-waiting
-                this_thread::sleep_for(chrono::milliseconds(100));
-            }
+    void wake(Session& conn) {
+        if (!conn.wakePending.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t ignored = write(conn.wakeFd, &one, sizeof(one));
+            (void)ignored;
         }
     }
 
-    void broadcastMessage(const string& message, int senderSocket) {
-        cout << "Broadcasting message: " << message << endl;
+    // Troca o snapshot de destinatários; o antigo é liberado quando nenhum leitor o usa mais
+    void publishRecipients(Room& room) {
+        auto next = make_unique<RecipientList>();
         for (int i = 0; i < MAX_CLIENTS; ++i) {
-            int clientSocket = clientSockets[i].load();
-            if (clientSocket != -1 && clientSocket != senderSocket) {
-                if (!sendAll(clientSocket, message.c_str(), message.length())) {
-                    cout << "Failed to send message to client " << i << " (socket " << clientSocket << ")" << endl;
+            if (room.joinedGeneration[i] != 0) {
+                next->recipients.push_back({i, room.joinedGeneration[i]});
+            }
+        }
+        room.recipients.publish(move(next));
+    }
+
+    // O executor é o único que publica o snapshot da sala, então pode lê-lo sem seção de leitura
+    void broadcastFrame(Room& room, const shared_ptr<const string>& frame, int excludeThreadId, EgressClass cls) {
+        deliver(*room.recipients.read(), excludeThreadId, frame, cls);
+    }
+
+    // Enfileira o frame para todos do snapshot (qualquer thread). Acima do limite a
+    // lista é partida entre os workers do fanoutPool e quem chama ajuda até o fim.
+    void deliver(const RecipientList& list, int excludeThreadId, const shared_ptr<const string>& frame,
+                 EgressClass cls) {
+        const vector<RecipientList::Recipient>& targets = list.recipients;
+        auto job = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                if (targets[i].slot != excludeThreadId) {
+                    pushEgress(targets[i].slot, targets[i].generation, frame, cls);
                 }
             }
+        };
+
+        if (fanoutPool && targets.size() >= config.fanoutThreshold) {
+            size_t partitions = fanoutPool->workerCount() * PARTITIONS_PER_FANOUT_THREAD;
+            fanoutPool->parallelFor(targets.size(), targets.size() / partitions, job);
+        } else {
+            job(0, targets.size());
+        }
+    }
+
+    void broadcastMessage(Room& room, const string& message, int excludeThreadId, EgressClass cls) {
+        cout << "Broadcasting message: " << message << endl;
+        broadcastFrame(room, make_shared<const string>(message), excludeThreadId, cls);
+    }
+
+    void recordMembershipChange(Room& room, bool added, const Member& member) {
+        room.membershipVersion++;
+        room.membershipLog.push_back({room.membershipVersion, added, member.username, member.publicKey});
+        if (room.membershipLog.size() > MEMBERSHIP_LOG_SIZE) {
+            room.membershipLog.pop_front();
+        }
+    }
+
+    // Remove do registro e avisa os demais com um delta
+    void removeMember(Room& room, MemberId id) {
+        if (!room.members.contains(id)) {
+            return;
+        }
+        recordMembershipChange(room, false, room.members.get(id));
+        room.members.remove(id);
+        broadcastMembershipChange(room, room.membershipLog.back(), -1);
+    }
+
+    static string membershipChangeMessage(const Room& room, const MembershipChange& change) {
+        nlohmann::json j = roomFrame(room, change.added ? "S2C_MEMBER_ADDED" : "S2C_MEMBER_REMOVED");
+        j["payload"]["version"] = change.version;
+        j["payload"]["username"] = change.username;
+        if (change.added) {
+            j["payload"]["publicKey"] = change.publicKey;
         }
+        return j.dump();
+    }
+
+    void broadcastMembershipChange(Room& room, const MembershipChange& change, int excludeThreadId) {
+        string msg = membershipChangeMessage(room, change);
+        cout << "Broadcasting membership change: " << msg << endl;
+        broadcastFrame(room, make_shared<const string>(msg), excludeThreadId, EgressClass::Control);
     }
-    void broadcastGroupMembersList() {
-        nlohmann::json j;
-        j["type"] = "S2C_GROUP_MEMBERS_LIST";
-        for (const auto& member : groupMembers) {
+
+    // Lista completa: só é enviada no join ou quando o log não cobre o buraco do cliente
+    void sendMembersSnapshot(Room& room, int threadId) {
+        nlohmann::json j = roomFrame(room, "S2C_GROUP_MEMBERS_LIST");
+        j["payload"]["version"] = room.membershipVersion;
+        j["payload"]["members"] = json::array();
+        for (MemberId id : room.members.ring()) {
+            const Member& member = room.members.get(id);
             nlohmann::json m;
             m["username"] = member.username;
             m["publicKey"] = member.publicKey;
             j["payload"]["members"].push_back(m);
         }
-        std::string msg = j.dump();
-        cout << "Broadcasting group members list: " << msg << endl;
+        sendTo(room, threadId, make_shared<const string>(j.dump()), EgressClass::Control);
+    }
+
+    void syncMembers(Room& room, int threadId, ull knownVersion) {
+        if (knownVersion >= room.membershipVersion) {
+            return;
+        }
+        if (room.membershipLog.empty() || room.membershipLog.front().version > knownVersion + 1) {
+            cout << "Membership log does not cover version " << knownVersion << ", sending snapshot" << endl;
+            sendMembersSnapshot(room, threadId);
+            return;
+        }
+        for (const auto& change : room.membershipLog) {
+            if (change.version > knownVersion) {
+                sendTo(room, threadId, make_shared<const string>(membershipChangeMessage(room, change)), EgressClass::Control);
+            }
+        }
+    }
+
+    // ========================================================================
+    // Heartbeats e timeouts de conexão (qualquer thread)
+    // ========================================================================
+
+    // Envia PING a cada cliente autenticado e derruba quem perdeu heartbeats demais.
+    // Uma conexão TCP meio-aberta pode levar horas para o recv falhar sozinho.
+    void heartbeatTick() {
+        json ping;
+        ping["type"] = "PING";
+        ping["payload"]["ts"] = nowUs();
+        auto frame = make_shared<const string>(ping.dump());
+
         for (int i = 0; i < MAX_CLIENTS; ++i) {
-            int clientSock = clientSockets[i].load();
-            if (clientSock != -1) {
-                if (!sendAll(clientSock, msg.c_str(), msg.size())) {
-                    cout << "Failed to send group members list to client " << i << " (socket " << clientSock << ")" << endl;
-                }
+            unsigned generation = sessions[i].authGeneration;
+            if (generation == 0 || sessions[i].generation != generation) {
+                continue;
+            }
+            if (sessions[i].missedHeartbeats >= config.maxMissedHeartbeats) {
+                evictClient(i, generation, "missed " + to_string(sessions[i].missedHeartbeats.load()) + " heartbeats", true);
+                continue;
+            }
+            sessions[i].missedHeartbeats++;
+            pushEgress(i, generation, frame, EgressClass::Control);
+        }
+        // Snapshots aposentados enquanto algum leitor estava no meio de um fan-out
+        forEachRoom([](Room& room) {
+            room.executor.post([&room] { room.fanoutEpochs.reclaim(); });
+        });
+        timers.schedule(config.heartbeatInterval, [this] { heartbeatTick(); });
+    }
+
+    // Derruba a conexão; a thread dona do socket trata a desconexão normalmente. Só uma
+    // conexão que parece ter caído (resumable) pode ser retomada com C2S_RESUME.
+    void evictClient(int threadId, unsigned generation, const string& reason, bool resumable = false) {
+        int clientSocket = sessions[threadId].socket.load();
+        if (clientSocket == -1 || sessions[threadId].generation != generation) {
+            return;
+        }
+        cout << "Evicting client on thread " << threadId << ": " << reason << endl;
+        sessions[threadId].resumable = resumable;
+        // Só fecha a leitura: a thread da conexão ainda tenta entregar o que está na fila
+        shutdown(clientSocket, SHUT_RD);
+    }
+
+    static long long nowMs() {
+        return chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Relógio de parede: a idade do histórico tem que valer entre execuções
+    static long long wallMs() {
+        return chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static long long nowUs() {
+        return chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Qualquer mensagem recebida prova que o cliente está vivo
+    void touch(int threadId) {
+        sessions[threadId].lastActivity = nowMs();
+        sessions[threadId].missedHeartbeats = 0;
+    }
+
+    void armAuthTimeout(int threadId) {
+        unsigned generation = sessions[threadId].generation;
+        timers.schedule(AUTH_TIMEOUT, [this, threadId, generation] {
+            if (sessions[threadId].authGeneration != generation) {
+                evictClient(threadId, generation, "authentication timeout");
+            }
+        });
+    }
+
+    // Re-arme preguiçoso: o timer não é reiniciado a cada mensagem, só confere a
+    // última atividade quando vence e reagenda pelo tempo restante
+    void armIdleTimeout(int threadId, unsigned generation, chrono::milliseconds delay) {
+        timers.schedule(delay, [this, threadId, generation] {
+            if (sessions[threadId].generation != generation || sessions[threadId].socket == -1) {
+                return;
+            }
+            long long idle = nowMs() - sessions[threadId].lastActivity;
+            if (idle >= IDLE_TIMEOUT.count()) {
+                evictClient(threadId, generation, "idle timeout");
+            } else {
+                armIdleTimeout(threadId, generation, chrono::milliseconds(IDLE_TIMEOUT.count() - idle));
+            }
+        });
+    }
+
+    // Sobrecarga global: algum executor demorando a rodar uma tarefa (CPU saturada) ou
+    // frames demais esperando nas filas de saída. Enquanto durar, o chat é recusado.
+    void checkOverload() {
+        long long now = nowUs();
+        long long lag = 0;
+        for (size_t i = 0; i < executors.size(); ++i) {
+            ExecutorProbe& probe = executorProbes[i];
+            long long postedAt = probe.postedAt;
+            if (postedAt != 0) {
+                // A sonda anterior ainda não rodou: o atraso é pelo menos a idade dela
+                lag = max(lag, now - postedAt);
+                continue;
             }
+            lag = max(lag, probe.lag.load());
+            probe.postedAt = now;
+            executors[i]->post([&probe] {
+                probe.lag = nowUs() - probe.postedAt;
+                probe.postedAt = 0;
+            });
+        }
+
+        size_t backlog = 0;
+        for (int i = 0; i < MAX_CLIENTS; ++i) {
+            backlog += sessions[i].backlog.load(memory_order_relaxed);
+        }
+        bool busy = lag > OVERLOAD_LAG.count() * 1000 || backlog > config.overloadBacklog;
+        if (busy != overloaded.exchange(busy)) {
+            cout << (busy ? "Overloaded" : "Load back to normal") << ": executor lag " << lag / 1000
+                 << " ms, egress backlog " << backlog << " frames" << endl;
+        }
+        timers.schedule(OVERLOAD_CHECK_INTERVAL, [this] { checkOverload(); });
+    }
+
+    void enforceHistoryRetention() {
+        long long now = wallMs();
+        forEachRoom([now](Room& room) { room.history->enforceRetention(now); });
+        timers.schedule(HISTORY_RETENTION_INTERVAL, [this] { enforceHistoryRetention(); });
+    }
+
+    void logLatencyStats() {
+        if (heartbeatRtt.count() > 0) {
+            cout << "Heartbeat RTT: " << heartbeatRtt.summary() << endl;
+        }
+        uint64_t shed = shedFrames.exchange(0);
+        if (shed > 0) {
+            cout << "Egress shed " << shed << " frames for slow clients" << endl;
         }
+        timers.schedule(STATS_INTERVAL, [this] { logLatencyStats(); });
     }
 
 public:
-    Server(int port) : clientSockets(MAX_CLIENTS), clientNames(MAX_CLIENTS), users(MAX_CLIENTS), 
-                       isRunning(true), keyExchangeInProgress(false), round1Completed(0), round2Completed(0) {
-        // Initialize client sockets to -1 (no client)
+    Server(const ServerConfig& config) : isRunning(true), config(config),
+                       sessions(new Session[MAX_CLIENTS]) {
+        // Os Sessions já nascem livres (socket -1, geração 0)
         for (int i = 0; i < MAX_CLIENTS; ++i) {
-            clientSockets[i] = -1;
-            // Inicializa estrutura User com valores padrão
-            users[i].username = "";
-            users[i].publicKey = 0;
-            users[i].hasCalculatedIntermediate = false;
-            users[i].intermediateValue = 0;
+            sessions[i].wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
         }
 
+        int executorCount = max(1, config.roomExecutors);
+        for (int i = 0; i < executorCount; ++i) {
+            executors.push_back(make_unique<Actor>("room-" + to_string(i)));
+        }
+        executorProbes.reset(new ExecutorProbe[executorCount]);
+        defaultRoom = &findOrCreateRoom(DEFAULT_ROOM);
+
         serverSocket = socket(AF_INET, SOCK_STREAM, 0);
         if (serverSocket < 0) {
             cerr << "Error creating socket" << endl;
@@ -570,7 +2102,7 @@ public:
         setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
         serverAddress.sin_family = AF_INET;
-        serverAddress.sin_port = htons(port);
+        serverAddress.sin_port = htons(config.port);
         serverAddress.sin_addr.s_addr = INADDR_ANY;
 
         if (bind(serverSocket, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) < 0) {
@@ -587,7 +2119,11 @@ public:
             return;
         }
 
-        cout << "Server started on port " << port << ". Waiting for connections..." << endl;
+        if (config.fanoutThreads > 0) {
+            fanoutPool = make_unique<FanoutPool>(config.fanoutThreads);
+        }
+
+        cout << "Server started on port " << config.port << ". Waiting for connections..." << endl;
     }
 
     ~Server() {
@@ -597,10 +2133,17 @@ public:
                 th.join();
             }
         }
+        if (timerThread.joinable()) {
+            timerThread.join();
+        }
+        for (auto& executor : executors) {
+            executor->stop();
+        }
         for(int i = 0; i < MAX_CLIENTS; ++i) {
-            if(clientSockets[i] != -1) {
-                close(clientSockets[i]);
+            if(sessions[i].socket != -1) {
+                close(sessions[i].socket);
             }
+            close(sessions[i].wakeFd);
         }
         close(serverSocket);
         cout << "Server shut down." << endl;
@@ -610,11 +2153,28 @@ public:
     void run() {
         if (!isRunning) return;
 
+        for (auto& executor : executors) {
+            executor->start();
+        }
+
         // Create worker threads
         for (int i = 0; i < MAX_CLIENTS; ++i) {
             workerThreads.emplace_back(&Server::handleClient, this, i);
         }
 
+        timers.schedule(config.heartbeatInterval, [this] { heartbeatTick(); });
+        timers.schedule(STATS_INTERVAL, [this] { logLatencyStats(); });
+        timers.schedule(OVERLOAD_CHECK_INTERVAL, [this] { checkOverload(); });
+        timers.schedule(HISTORY_RETENTION_INTERVAL, [this] { enforceHistoryRetention(); });
+
+        // Thread que avança o timer wheel e dispara os prazos vencidos
+        timerThread = thread([this] {
+            while (isRunning) {
+                this_thread::sleep_for(timers.tickDuration());
+                timers.advance();
+            }
+        });
+
         // Main loop to accept new connections
         while (isRunning) {
             int clientSocket = accept(serverSocket, nullptr, nullptr);
@@ -625,8 +2185,12 @@ public:
 
             bool assigned = false;
             for (int i = 0; i < MAX_CLIENTS; ++i) {
-                if (clientSockets[i] == -1) {
-                    clientSockets[i] = clientSocket;
+                if (sessions[i].socket == -1 && !sessions[i].parked) {
+                    sessions[i].generation++;
+                    sessions[i].resumable = true;
+                    touch(i);
+                    sessions[i].socket = clientSocket;
+                    armAuthTimeout(i);
                     assigned = true;
                     break;
                 }
@@ -639,4 +2203,4 @@ public:
             }
         }
     }
-};
\ No newline at end of file
+};
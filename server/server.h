@@ -1,10 +1,28 @@
 #pragma once
-#include <vector>
+#include <chrono>
+#include <cstddef>
 #include <string>
+#include <thread>
 
-struct GrupMember {
-    std::string username;
-    unsigned long long publicKey;
+// Parâmetros ajustáveis pela linha de comando (ver mainServer.cpp)
+struct ServerConfig {
+    int port = 8080;
+    std::chrono::milliseconds heartbeatInterval{5000}; // Intervalo entre PINGs para cada cliente
+    int maxMissedHeartbeats = 3;                       // PINGs sem resposta antes de derrubar a conexão
+    int fanoutThreads = std::thread::hardware_concurrency(); // Workers do fan-out paralelo (0 = desliga)
+    size_t fanoutThreshold = 1024;                     // Destinatários a partir dos quais o fan-out é paralelo
+    int roomExecutors = std::thread::hardware_concurrency(); // Executores que dividem as salas entre si
+    // Token buckets (por segundo; 0 = sem limite). A rajada aceita é de 2 segundos de taxa.
+    double clientMessageRate = 20;                     // Frames por conexão
+    double clientByteRate = 64 * 1024;                 // Bytes recebidos por conexão
+    double roomMessageRate = 200;                      // Mensagens de chat por sala
+    double roomByteRate = 8 * 1024 * 1024;             // Bytes de chat multiplicados pelo fan-out, por sala
+    size_t overloadBacklog = 50000;                    // Frames nas filas de saída que indicam sobrecarga
+    // Histórico de mensagens cifradas, um log de segmentos por sala ("" = não guarda)
+    std::string historyDir = "history";
+    size_t historySegmentBytes = 4 * 1024 * 1024;      // Capacidade de cada segmento
+    size_t historyMaxBytes = 64 * 1024 * 1024;         // Por sala; os segmentos mais antigos saem primeiro
+    std::chrono::seconds historyMaxAge{24 * 60 * 60};  // Segmentos sem mensagens mais novas que isso saem
+    std::chrono::milliseconds resumeGrace{30000};      // Prazo para C2S_RESUME depois de uma queda (0 = desliga)
+    int fastJoinLimit = 16;                            // Entradas seguidas sem troca completa de chaves (0 = desliga)
 };
-
-extern std::vector<GrupMember> groupMembers;
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick)
+    : tick(tick), start(Clock::now()), wheel(LEVELS * SLOTS) {}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Arredonda para cima: o timer nunca dispara antes do atraso pedido
+    auto deadline = Clock::now() - start + delay;
+    uint64_t expires = (deadline + tick - Clock::duration(1)) / tick;
+    // Nem cai no slot que já foi processado neste tick
+    if (expires <= currentTick) {
+        expires = currentTick + 1;
+    }
+
+    TimerId id = nextId++;
+    Slot& slot = slotFor(expires);
+    slot.push_back({id, expires, std::move(callback)});
+    index[id] = {&slot, std::prev(slot.end())};
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = index.find(id);
+    if (found == index.end()) {
+        return false;
+    }
+    found->second.slot->erase(found->second.it);
+    index.erase(found);
+    return true;
+}
+
+void TimerWheel::advance() {
+    uint64_t target = (Clock::now() - start) / tick;
+
+    while (true) {
+        Slot expired;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (currentTick >= target) {
+                return;
+            }
+            currentTick++;
+
+            // Quando um nível dá a volta, desce os timers do próximo nível
+            for (int level = 1; level < LEVELS; ++level) {
+                if ((currentTick >> ((level - 1) * SLOT_BITS)) & SLOT_MASK) {
+                    break;
+                }
+                cascade(level);
+            }
+
+            Slot& due = wheel[currentTick & SLOT_MASK];
+            expired.splice(expired.end(), due);
+            for (const Timer& timer : expired) {
+                index.erase(timer.id);
+            }
+        }
+
+        for (Timer& timer : expired) {
+            timer.callback();
+        }
+    }
+}
+
+TimerWheel::Slot& TimerWheel::slotFor(uint64_t expires) {
+    uint64_t delta = expires - currentTick;
+    for (int level = 0; level < LEVELS; ++level) {
+        if (delta < (1ULL << ((level + 1) * SLOT_BITS))) {
+            return wheel[level * SLOTS + ((expires >> (level * SLOT_BITS)) & SLOT_MASK)];
+        }
+    }
+    // Além do alcance: fica no último slot alcançável do nível mais alto
+    uint64_t last = currentTick + (1ULL << (LEVELS * SLOT_BITS)) - 1;
+    return wheel[(LEVELS - 1) * SLOTS + ((last >> ((LEVELS - 1) * SLOT_BITS)) & SLOT_MASK)];
+}
+
+void TimerWheel::cascade(int level) {
+    Slot& slot = wheel[level * SLOTS + ((currentTick >> (level * SLOT_BITS)) & SLOT_MASK)];
+    while (!slot.empty()) {
+        auto it = slot.begin();
+        Slot& target = slotFor(it->expires);
+        // splice mantém o iterador válido, só o slot dono muda
+        target.splice(target.end(), slot, it);
+        index[it->id].slot = &target;
+    }
+}
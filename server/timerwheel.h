@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Timer wheel hierárquico (estilo kernel Linux) com 4 níveis de 64 slots.
+ *
+ * Agendar e cancelar custam O(1); timers distantes ficam nos níveis superiores e
+ * descem (cascade) para o nível 0 quando o ponteiro do nível de baixo dá a volta.
+ * Com tick de 10ms o alcance é de 64^4 ticks (~46 horas).
+ *
+ * Os callbacks são executados por quem chama advance(), fora do lock interno,
+ * então podem agendar ou cancelar outros timers.
+ */
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+    // Retorna false se o timer já disparou ou foi cancelado
+    bool cancel(TimerId id);
+    // Processa todos os ticks até o instante atual e dispara os timers vencidos
+    void advance();
+
+    std::chrono::milliseconds tickDuration() const { return tick; }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+
+    struct Timer {
+        TimerId id;
+        uint64_t expires;
+        Callback callback;
+    };
+    using Slot = std::list<Timer>;
+
+    struct Location {
+        Slot* slot;
+        Slot::iterator it;
+    };
+
+    std::chrono::milliseconds tick;
+    Clock::time_point start;
+    uint64_t currentTick = 0;
+    TimerId nextId = 1;
+
+    std::mutex mutex;
+    std::vector<Slot> wheel;                       // LEVELS * SLOTS
+    std::unordered_map<TimerId, Location> index;
+
+    Slot& slotFor(uint64_t expires);
+    void cascade(int level);
+};
@@ -0,0 +1,53 @@
+#include "tokenbucket.h"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate, double burst) {
+    configure(rate, burst);
+}
+
+void TokenBucket::configure(double rate, double burst) {
+    usPerToken = rate > 0 ? 1e6 / rate : 0;
+    toleranceUs = (int64_t)(std::max(burst, 1.0) * usPerToken);
+    fullAt = 0;
+}
+
+int64_t TokenBucket::tryConsume(double n, int64_t nowUs) {
+    if (unlimited()) {
+        return 0;
+    }
+    int64_t cost = costOf(n);
+    int64_t current = fullAt.load(std::memory_order_relaxed);
+    while (true) {
+        int64_t next = std::max(current, nowUs) + cost;
+        // Passaria do burst: espera até o excesso escoar
+        if (next - nowUs > toleranceUs) {
+            return next - nowUs - toleranceUs;
+        }
+        if (fullAt.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+            return 0;
+        }
+    }
+}
+
+int64_t TokenBucket::delayFor(double n, int64_t nowUs) const {
+    if (unlimited()) {
+        return 0;
+    }
+    int64_t next = std::max(fullAt.load(std::memory_order_relaxed), nowUs) + costOf(n);
+    return std::max<int64_t>(0, next - nowUs - toleranceUs);
+}
+
+void TokenBucket::refund(double n) {
+    if (unlimited()) {
+        return;
+    }
+    fullAt.fetch_sub(costOf(n), std::memory_order_relaxed);
+}
+
+int64_t TokenBucket::costOf(double n) const {
+    // Um pedido maior que o burst inteiro passa quando o balde está cheio, senão nunca passaria.
+    // A comparação é feita em double: o produto pode não caber em int64_t.
+    double cost = n * usPerToken;
+    return cost >= (double)toleranceUs ? toleranceUs : (int64_t)cost;
+}
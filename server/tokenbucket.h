@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Token bucket implementado como GCRA (virtual scheduling).
+ *
+ * Em vez de contar tokens, guarda o instante teórico em que o balde volta a ficar
+ * cheio; consumir é um CAS nesse instante, então o mesmo balde pode ser dividido
+ * entre threads (limite por sala) sem lock. Tempos em microssegundos.
+ */
+class TokenBucket {
+public:
+    // rate: tokens por segundo (0 = sem limite); burst: tokens acumuláveis
+    TokenBucket(double rate = 0, double burst = 0);
+
+    void configure(double rate, double burst);
+
+    // Consome n tokens se houver. Caso contrário não consome nada e retorna quantos
+    // microssegundos faltam para haver; 0 significa que consumiu.
+    int64_t tryConsume(double n, int64_t nowUs);
+    // Mesmo cálculo de tryConsume, sem consumir
+    int64_t delayFor(double n, int64_t nowUs) const;
+    // Devolve n tokens consumidos por tryConsume (ex.: outro balde recusou o mesmo pedido)
+    void refund(double n);
+
+    bool unlimited() const { return usPerToken == 0; }
+
+private:
+    double usPerToken = 0;   // Intervalo de emissão
+    int64_t toleranceUs = 0; // burst convertido em tempo
+    std::atomic<int64_t> fullAt{0};  // Instante teórico de chegada (TAT do GCRA)
+
+    int64_t costOf(double n) const;
+};